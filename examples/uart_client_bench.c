@@ -0,0 +1,256 @@
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <stdlib.h>
+#include "uart_client.h"
+
+#define LOG_TAG              "uart.client.bench"
+#define LOG_LVL              LOG_LVL_INFO
+#include <ulog.h>
+
+/*
+ * Receive engine benchmark, no wiring required.
+ *
+ * A memory backed character device plays the UART driver. Each round the
+ * scheduler is locked while a burst is pushed into it with rx_indicate raised
+ * once per byte, as the serial framework does in interrupt mode, then the time
+ * until the consumer has drained the burst is measured. The same bursts are
+ * consumed once by a reference loop that reads one byte per rt_device_read()
+ * and takes the notification semaphore per byte (the former
+ * uart_client_getbyte() engine), and once by a uart client.
+ */
+
+#define BENCH_DEV_NAME          "ucbench"
+#define BENCH_REF_DEV_NAME      "ucbref"
+#define BENCH_FRAME_TIMEOUT_MS  10
+
+struct bench_device
+{
+    struct rt_device parent;
+    rt_uint8_t *ring;
+    rt_size_t ring_size;
+    rt_size_t head;
+    rt_size_t tail;
+};
+
+static struct bench_device bench_dev, bench_ref_dev;
+static struct rt_semaphore bench_ref_sem;
+static struct rt_semaphore bench_done_sem;
+static volatile rt_size_t bench_rx_bytes;
+static rt_size_t bench_burst;
+static rt_size_t bench_rounds;
+
+static rt_err_t bench_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    /* behave like a UART without DMA so the client falls back to interrupt mode */
+    return (oflag & RT_DEVICE_FLAG_DMA_RX) ? -RT_EIO : RT_EOK;
+}
+
+static rt_size_t bench_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct bench_device *bdev = (struct bench_device *) dev;
+    rt_uint8_t *out = buffer;
+    rt_size_t len = 0;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    while (len < size && bdev->tail != bdev->head)
+    {
+        out[len++] = bdev->ring[bdev->tail];
+        bdev->tail = (bdev->tail + 1) % bdev->ring_size;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return len;
+}
+
+static rt_size_t bench_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return size;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+static const struct rt_device_ops bench_ops =
+{
+    RT_NULL,
+    bench_open,
+    RT_NULL,
+    bench_read,
+    bench_write,
+    RT_NULL
+};
+#endif
+
+static rt_err_t bench_register(struct bench_device *bdev, const char *name, rt_size_t ring_size)
+{
+    if (bdev->ring_size < ring_size)
+    {
+        rt_free(bdev->ring);
+        bdev->ring = rt_malloc(ring_size);
+        if (bdev->ring == RT_NULL)
+        {
+            bdev->ring_size = 0;
+            return -RT_ENOMEM;
+        }
+        bdev->ring_size = ring_size;
+    }
+    bdev->head = bdev->tail = 0;
+
+    if (rt_device_find(name) != RT_NULL)
+        return RT_EOK;
+
+    bdev->parent.type = RT_Device_Class_Char;
+#ifdef RT_USING_DEVICE_OPS
+    bdev->parent.ops = &bench_ops;
+#else
+    bdev->parent.open = bench_open;
+    bdev->parent.read = bench_read;
+    bdev->parent.write = bench_write;
+#endif
+    return rt_device_register(&bdev->parent, name, RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
+}
+
+/* push one burst with the scheduler locked, raising rx_indicate once per byte */
+static void bench_feed(struct bench_device *bdev, rt_size_t size)
+{
+    rt_size_t count;
+    rt_base_t level;
+
+    rt_enter_critical();
+    while (size--)
+    {
+        level = rt_hw_interrupt_disable();
+        bdev->ring[bdev->head] = (rt_uint8_t) size;
+        bdev->head = (bdev->head + 1) % bdev->ring_size;
+        count = (bdev->head + bdev->ring_size - bdev->tail) % bdev->ring_size;
+        if (bdev->parent.rx_indicate)
+        {
+            bdev->parent.rx_indicate(&bdev->parent, count);
+        }
+        rt_hw_interrupt_enable(level);
+    }
+    rt_exit_critical();
+}
+
+/* feed every round and return the ticks spent waiting for the consumer */
+static rt_tick_t bench_run(struct bench_device *bdev)
+{
+    rt_tick_t ticks = 0, start;
+
+    for (rt_size_t i = 0; i < bench_rounds; i++)
+    {
+        bench_feed(bdev, bench_burst);
+        start = rt_tick_get();
+        rt_sem_take(&bench_done_sem, RT_WAITING_FOREVER);
+        ticks += rt_tick_get() - start;
+    }
+
+    return ticks;
+}
+
+static rt_err_t bench_ref_rx_ind(rt_device_t dev, rt_size_t size)
+{
+    rt_sem_release(&bench_ref_sem);
+    return RT_EOK;
+}
+
+/* the per-byte engine this package used before the bulk drain */
+static void bench_ref_entry(void *parameter)
+{
+    rt_uint8_t ch;
+
+    for (rt_size_t i = 0; i < bench_rounds; i++)
+    {
+        for (rt_size_t received = 0; received < bench_burst; received++)
+        {
+            while (rt_device_read(&bench_ref_dev.parent, 0, &ch, 1) == 0)
+            {
+                rt_sem_take(&bench_ref_sem, RT_WAITING_FOREVER);
+            }
+        }
+        rt_sem_release(&bench_done_sem);
+    }
+}
+
+static void bench_frame_handler(rt_uint8_t *frame_data, rt_size_t size)
+{
+    bench_rx_bytes += size;
+    if (bench_rx_bytes >= bench_burst)
+    {
+        bench_rx_bytes -= bench_burst;
+        rt_sem_release(&bench_done_sem);
+    }
+}
+
+static void bench_report(const char *name, rt_size_t bytes, rt_tick_t ticks)
+{
+    if (ticks == 0)
+        ticks = 1;
+    LOG_I("%-12s %8d bytes in %6d ticks, %10d bytes/s", name, bytes, ticks,
+            (rt_uint32_t) ((rt_uint64_t) bytes * RT_TICK_PER_SECOND / ticks));
+}
+
+static void uart_client_bench_rx(int argc, char **argv)
+{
+    static uart_client_t client = RT_NULL;
+    static rt_size_t buf_size = 256;
+    rt_thread_t ref_thread;
+    rt_tick_t ticks;
+
+    bench_burst = 4096;
+    bench_rounds = 64;
+    if (argc > 1)
+        bench_burst = atoi(argv[1]);
+    if (argc > 2)
+        bench_rounds = atoi(argv[2]);
+    if (argc > 3 && client == RT_NULL)
+        buf_size = atoi(argv[3]);
+    if (buf_size < 2)
+        buf_size = 2;
+    /* whole frames per burst so no round ends on the idle timeout */
+    bench_burst -= bench_burst % (buf_size - 1);
+    if (bench_burst == 0)
+        bench_burst = buf_size - 1;
+
+    if (bench_register(&bench_dev, BENCH_DEV_NAME, bench_burst + 1) != RT_EOK
+            || bench_register(&bench_ref_dev, BENCH_REF_DEV_NAME, bench_burst + 1) != RT_EOK)
+    {
+        LOG_E("no memory for %d byte bench ring!", bench_burst + 1);
+        return;
+    }
+    rt_sem_init(&bench_ref_sem, "ucbref", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&bench_done_sem, "ucbdone", 0, RT_IPC_FLAG_FIFO);
+
+    /* reference: one read per byte and one semaphore take per empty read */
+    rt_device_open(&bench_ref_dev.parent, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
+    rt_device_set_rx_indicate(&bench_ref_dev.parent, bench_ref_rx_ind);
+    ref_thread = rt_thread_create("ucbref", bench_ref_entry, RT_NULL, 1024, PKG_UART_CLIENT_PRIORITY_START, 20);
+    if (ref_thread == RT_NULL)
+    {
+        LOG_E("no memory for reference thread!");
+        goto __exit;
+    }
+    rt_thread_startup(ref_thread);
+    ticks = bench_run(&bench_ref_dev);
+    bench_report("per-byte", bench_burst * bench_rounds, ticks);
+    rt_device_set_rx_indicate(&bench_ref_dev.parent, RT_NULL);
+    rt_device_close(&bench_ref_dev.parent);
+
+    /* uart client receive engine, frames end when recv_buf fills up */
+    if (client == RT_NULL)
+    {
+        client = uart_client_create(BENCH_DEV_NAME, buf_size, 0, BENCH_FRAME_TIMEOUT_MS, bench_frame_handler);
+        if (client == RT_NULL)
+        {
+            LOG_E("bench client create failed!");
+            goto __exit;
+        }
+    }
+    bench_rx_bytes = 0;
+    ticks = bench_run(&bench_dev);
+    bench_report("uart_client", bench_burst * bench_rounds, ticks);
+
+__exit:
+    rt_sem_detach(&bench_ref_sem);
+    rt_sem_detach(&bench_done_sem);
+}
+MSH_CMD_EXPORT(uart_client_bench_rx, uart client rx engine benchmark: [burst] [rounds] [recv_buf_size]);
@@ -13,8 +13,13 @@
 #define RECV_BUF_SIZE       (256)
 #define FRAME_TIMEOUT_MS	500
 #define SEND_INTERVAL_MS    1000
+#define TX_QUEUE_MSG_SIZE   (128)
+#define TX_QUEUE_DEPTH      4
+#define AUTO_TIMEOUT_MIN_MS 50
 
 static uart_client_t client = RT_NULL;
+//配置命令重复执行结果相同，超时后最多再试2次
+static const struct uart_retry request_retry = { 3, UART_RETRY_IDEMPOTENT, 100, 400 };
 
 void uart_set_frame_handler(void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
 {
@@ -26,7 +31,8 @@ rt_err_t uart_request_no_response(rt_uint8_t *frame_data, rt_uint16_t frame_len)
 	rt_err_t res;
 	if(client != RT_NULL)
 	{
-		res = uart_client_request_no_response(client, frame_data, frame_len);
+		//交给发送线程按SEND_INTERVAL_MS间隔发送，立即返回
+		res = uart_client_request_enqueue(client, frame_data, frame_len);
 	}
 	else
 	{
@@ -77,19 +83,17 @@ rt_err_t uart_set_config(char *params)
     rt_err_t res;
 	if(client == RT_NULL) return -RT_EEMPTY;
 
-    rt_bool_t consume = RT_FALSE;
+	char resp_buf[32] = {0};
+	rt_size_t resp_size = 0;
 	char *frame_data = params;
 	rt_uint16_t frame_len = rt_strlen(frame_data);
-	res = uart_request_start((rt_uint8_t*)frame_data, frame_len, 2000);
+	//响应复制到resp_buf后立即释放客户端，无需调用uart_request_end
+	res = uart_client_transact(client, 2000, (rt_uint8_t*)frame_data, frame_len, (rt_uint8_t*)resp_buf, sizeof(resp_buf) - 1, &resp_size);
     LOG_HEX("req_buf", 16, (rt_uint8_t*)frame_data, frame_len);
 	if(res == RT_EOK)
 	{
-		LOG_HEX("client->resp.buf", 16, client->resp.buf, client->resp.buf_size);
-        if(rt_strstr((char*)client->resp.buf, "OK"))
-        {
-			consume = RT_TRUE;
-        }
-        else
+		LOG_HEX("resp_buf", 16, (rt_uint8_t*)resp_buf, resp_size);
+        if(!rt_strstr(resp_buf, "OK"))
         {
             res = -RT_ETIMEOUT;
         }
@@ -98,12 +102,11 @@ rt_err_t uart_set_config(char *params)
 	{
 		LOG_E("set config failed(%d)", res);
 	}
-	uart_request_end(consume);
 
     return res;
 }
 
-int uart_client_init(void)
+int uart_init(void)
 {
     struct rt_serial_device *serial_device = (struct rt_serial_device *)rt_device_find(UART_NAME);
     if(serial_device == RT_NULL)
@@ -119,12 +122,20 @@ int uart_client_init(void)
         LOG_E("uart client init failed!");
         return -RT_ERROR;
     }
+    if(uart_client_tx_queue_create(client, TX_QUEUE_MSG_SIZE, TX_QUEUE_DEPTH, UART_TX_DROP_OLDEST, 0) != RT_EOK)
+    {
+        LOG_E("uart client tx queue init failed!");
+        return -RT_ERROR;
+    }
+    //请求的timeout_ms只作上限，按测得的往返时间等待响应
+    uart_client_set_auto_timeout(client, RT_TRUE, AUTO_TIMEOUT_MIN_MS);
+    uart_client_set_retry(client, &request_retry);
 
     LOG_I("uart client init success!");
 
     return RT_EOK;
 }
-INIT_APP_EXPORT(uart_client_init);
+INIT_APP_EXPORT(uart_init);
 
 void set_datetime(void)
 {
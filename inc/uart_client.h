@@ -3,6 +3,44 @@
 
 #ifdef PKG_USING_UART_CLIENT
 
+#ifndef PKG_UART_CLIENT_THREAD_STACK_SIZE
+#define PKG_UART_CLIENT_THREAD_STACK_SIZE	512
+#endif
+
+/* number of recv_buf_size frame buffers per client, one is always receiving */
+#ifndef PKG_UART_CLIENT_FRAME_NUM
+#define PKG_UART_CLIENT_FRAME_NUM	2
+#endif
+
+/* longest terminator string of UART_FRAME_TERMINATOR */
+#ifndef PKG_UART_CLIENT_TERMINATOR_MAX
+#define PKG_UART_CLIENT_TERMINATOR_MAX	8
+#endif
+
+/* character times the RS485 DE pin stays driven after the blocking write returns */
+#ifndef PKG_UART_CLIENT_DE_TURNAROUND_CHARS
+#define PKG_UART_CLIENT_DE_TURNAROUND_CHARS	2
+#endif
+
+/*
+ * Compile-time profile. Everything is built by default; a product that knows its
+ * protocol narrows it and the paths it never takes are stripped from the client.
+ */
+
+/* framing modes built in, UART_FRAME_BUILD_* bits; idle framing is always there */
+#ifndef PKG_UART_CLIENT_FRAME_MODES
+#define PKG_UART_CLIENT_FRAME_MODES	0x3E
+#endif
+
+/*
+ * PKG_UART_CLIENT_USING_INT_RX: open in interrupt mode even where the driver has DMA.
+ * PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL: no pacing timer, send_interval_ms must be 0.
+ * PKG_UART_CLIENT_WITHOUT_RS485: no *_with_rs485 variants and no DE pin.
+ */
+#if defined(RT_USING_PIN) && !defined(PKG_UART_CLIENT_WITHOUT_RS485)
+#define UART_CLIENT_USING_DE_PIN
+#endif
+
 struct uart_response
 {
 	rt_uint8_t *buf;
@@ -10,36 +48,379 @@ struct uart_response
 	rt_uint32_t timeout;
 };
 
+enum uart_frame_mode
+{
+	UART_FRAME_IDLE = 0,		/* a frame ends after frame_timeout_ms without data */
+	UART_FRAME_LENGTH,			/* length field in the header */
+	UART_FRAME_DELIMITER,		/* start/end bytes with escaping, SLIP/HDLC style */
+	UART_FRAME_TERMINATOR,		/* terminator string such as "\r\n", kept in the frame */
+	UART_FRAME_MODBUS_RTU,		/* 3.5 character silence at the configured baud rate */
+	UART_FRAME_USER,			/* user callback */
+};
+
+/* PKG_UART_CLIENT_FRAME_MODES bits, 1 << mode spelled out for #if */
+#define UART_FRAME_BUILD_LENGTH		0x02
+#define UART_FRAME_BUILD_DELIMITER	0x04
+#define UART_FRAME_BUILD_TERMINATOR	0x08
+#define UART_FRAME_BUILD_MODBUS_RTU	0x10
+#define UART_FRAME_BUILD_USER		0x20
+
+struct uart_frame_config
+{
+	enum uart_frame_mode mode;
+	union
+	{
+		/* frame size = length field value + adjust, both counted from the first frame byte */
+		struct
+		{
+			rt_uint16_t offset;
+			rt_uint8_t size;
+			rt_uint8_t big_endian;
+			rt_int16_t adjust;
+		} length;
+		/* delimiters are stripped, escape followed by escape_xxx decodes to xxx */
+		struct
+		{
+			rt_uint8_t start;
+			rt_uint8_t end;
+			rt_uint8_t escape;
+			rt_uint8_t escape_start;
+			rt_uint8_t escape_end;
+			rt_uint8_t escape_escape;
+		} delimiter;
+		const char *terminator;
+		/* returns the frame size once buf holds a complete frame, 0 otherwise */
+		rt_size_t (*check)(const rt_uint8_t *buf, rt_size_t size);
+	} param;
+};
+
+/* frame_timeout_ms value: frames end after 3.5 character times of silence at the current serial settings */
+#define UART_CLIENT_FRAME_TIMEOUT_AUTO	0xFFFFFFFFUL
+
+#define UART_FRAME_STATE_IN_FRAME	0x01
+#define UART_FRAME_STATE_ESCAPED	0x02
+#define UART_FRAME_STATE_ABORTED	0x04
+
+struct uart_frame_state
+{
+	rt_size_t size;
+	rt_uint32_t value;
+	rt_uint8_t flags;
+	rt_size_t end;				/* completed frame waiting for a buffer for the bytes behind it */
+};
+
+enum uart_frame_end
+{
+	UART_FRAME_END_IDLE = 0,	/* the line stayed idle for the frame timeout */
+	UART_FRAME_END_DELIMITER,	/* the framer found the end of the frame */
+	UART_FRAME_END_ERROR,		/* cut short, e.g. a new start delimiter inside the frame */
+};
+
+/*
+ * Incremental delivery of unsolicited frames. A frame that does not fit into
+ * recv_buf is passed on in recv_buf sized chunks as it arrives instead of being
+ * cut; UART_FRAME_USER check callbacks only see the current chunk.
+ */
+struct uart_stream_handler
+{
+	void (*begin)(void);
+	void (*chunk)(const rt_uint8_t *data, rt_size_t size);
+	void (*end)(enum uart_frame_end reason, rt_size_t size);
+};
+
+struct uart_iovec
+{
+	const void *base;
+	rt_size_t len;
+};
+
+/* One request of uart_client_request_batch(), timeout_ms 0 expects no response */
+struct uart_batch_item
+{
+	const rt_uint8_t *req_buf;
+	rt_size_t req_size;
+	rt_uint32_t timeout_ms;
+	rt_uint8_t *resp_buf;
+	rt_size_t resp_buf_size;
+	rt_size_t resp_size;		/* out: bytes copied to resp_buf */
+	rt_err_t result;			/* out */
+	rt_tick_t rtt;				/* out: ticks from the write to the response */
+};
+
+/*
+ * CRC or checksum (update(init, ...) ^ xor_out), size bytes wide: appended after the
+ * last segment on TX, checked and stripped on RX. uart_client_crc.h has built-in ones.
+ */
+struct uart_tx_crc
+{
+	rt_uint32_t init;
+	rt_uint32_t xor_out;
+	rt_uint32_t (*update)(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size);
+	rt_uint8_t size;
+	rt_uint8_t big_endian;
+};
+
+enum uart_tx_overflow
+{
+	UART_TX_DROP_NEWEST = 0,	/* reject the request being queued */
+	UART_TX_DROP_OLDEST,		/* overwrite the oldest queued request */
+	UART_TX_BLOCK,				/* wait up to block_ms for room */
+};
+
+struct uart_tx_queue_stat
+{
+	rt_uint32_t depth;
+	rt_uint32_t peak;
+	rt_uint32_t enqueued;
+	rt_uint32_t sent;
+	rt_uint32_t dropped;
+};
+
+struct uart_tx_queue
+{
+	rt_mp_t pool;
+	rt_mailbox_t mb;
+	rt_thread_t sender;
+	rt_size_t msg_size;
+	enum uart_tx_overflow policy;
+	rt_int32_t block_ticks;
+	struct uart_tx_queue_stat stat;
+};
+
+#define UART_CLIENT_HIST_BUCKETS	16
+
+/* Request lanes, the wire goes to the most urgent lane with a queued request first */
+enum uart_lane
+{
+	UART_LANE_HIGH = 0,
+	UART_LANE_NORMAL,
+	UART_LANE_BULK,
+	UART_LANE_NUM,
+};
+
+struct uart_lane_stats
+{
+	rt_uint32_t requests;
+	rt_uint32_t preempted;		/* queued bulk requests failed by a high lane request */
+	rt_tick_t wait_max;
+	rt_uint32_t wait_hist[UART_CLIENT_HIST_BUCKETS];
+};
+
+/* RFC 6298 style round trip estimate in ticks, see uart_client_set_auto_timeout() */
+struct uart_rtt
+{
+	rt_int32_t srtt;			/* smoothed rtt << 3 */
+	rt_int32_t rttvar;			/* mean deviation << 2 */
+	rt_uint32_t samples;		/* 0: no estimate yet */
+	rt_uint8_t backoff;			/* timeouts since the last sample, each doubles the rto */
+};
+
+/* retry flags */
+#define UART_RETRY_IDEMPOTENT	0x01	/* requests may be sent again after a timeout */
+
+struct uart_retry
+{
+	rt_uint8_t attempts;		/* tries in all, 0 or 1: no retry */
+	rt_uint8_t flags;
+	rt_uint32_t backoff_ms;		/* before the second try, doubled for each further one */
+	rt_uint32_t backoff_max_ms;
+};
+
+/* Counters are updated without locking; histogram bucket i counts values in [2^(i-1), 2^i) ticks */
+struct uart_client_stats
+{
+	rt_uint32_t rx_bytes;
+	rt_uint32_t rx_frames;
+	rt_uint32_t tx_bytes;
+	rt_uint32_t tx_frames;
+	rt_uint32_t requests;
+	rt_uint32_t timeouts;
+	rt_uint32_t retries;
+	rt_uint32_t consumed;		/* frames taken by a requester or transaction */
+	rt_uint32_t handled;		/* frames passed to frame_handler */
+	rt_uint32_t truncated;		/* frames cut at recv_buf_size - 1 */
+	rt_uint32_t rx_coalesced;	/* rx indications folded into a pending wakeup */
+	rt_uint32_t rx_crc_errors;
+	rt_uint32_t end_reclaims;	/* request_start() without request_end(), wire taken back */
+	rt_uint32_t rtt_hist[UART_CLIENT_HIST_BUCKETS];
+	rt_uint32_t wait_hist[UART_CLIENT_HIST_BUCKETS];	/* blocked on the lane and tx_sem */
+	struct uart_lane_stats lanes[UART_LANE_NUM];
+};
+
+struct uart_transaction
+{
+	rt_list_t list;
+	rt_uint32_t key;
+	rt_tick_t start;
+	rt_tick_t deadline;
+	struct rt_semaphore done;
+	rt_uint8_t *buf;
+	rt_size_t buf_size;
+	rt_size_t resp_size;
+	rt_err_t result;
+};
+typedef struct uart_transaction *uart_transaction_t;
+
 struct uart_client
 {
 	rt_device_t device;
+	rt_uint8_t index;				/* below PKG_UART_CLIENT_MAX_COUNT, at most 256 */
+	struct rt_mempool frame_pool;
 	rt_uint8_t *recv_buf;
 	rt_size_t recv_buf_size;
+	rt_size_t recv_len;
 	rt_uint32_t frame_timeout_ms;
-	rt_sem_t rx_notice;
-	rt_sem_t tx_sem;
-	rt_mailbox_t rx_mb;
-    rt_mutex_t lock;
+	struct uart_frame_config frame_cfg;
+	struct uart_frame_state frame_state;
+	rt_size_t terminator_len;
+	rt_uint8_t terminator_next[PKG_UART_CLIENT_TERMINATOR_MAX];	/* KMP failure table of the terminator */
+	volatile rt_bool_t rx_pending;
+	volatile rt_uint8_t rx_flags;
+#ifdef RT_USING_HWTIMER
+	rt_device_t gap_timer;
+#endif
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+	struct rt_timer idle_timer;
+#else
+	struct rt_semaphore rx_notice;
+	struct rt_thread parser;
+#endif
+	struct rt_semaphore tx_sem;
+
+	/* request arbitration in place of a FIFO lock, see uart_client_set_lanes() */
+	struct rt_semaphore lane_grant[UART_LANE_NUM];
+	rt_uint16_t lane_waiting[UART_LANE_NUM];
+	rt_uint16_t lane_cancel;		/* grants to be taken as -RT_EINTR by bulk waiters */
+	rt_thread_t lane_owner;			/* RT_NULL while the wire is handed over */
+	rt_uint16_t lane_hold;			/* nested requests of the owner */
+	rt_bool_t end_owed;				/* the owner returned from request_start() */
+	rt_tick_t end_since;
+	rt_uint8_t lane_owner_prio;		/* owner priority before a waiter lent it its own */
+	rt_uint8_t lane_lent_prio;		/* priority lent to the owner, RT_THREAD_PRIORITY_MAX if none */
+	rt_uint8_t lane_high_prio;
+	rt_uint8_t lane_bulk_prio;
+	rt_bool_t lane_preempt;
+	rt_bool_t lane_busy;
 
 	struct uart_response resp;
-	rt_sem_t resp_notice;
-	rt_sem_t resp_end_notice;
-	rt_bool_t resp_consume;
+	struct rt_semaphore resp_notice;
+	rt_list_t trans_list;
+	rt_err_t (*matcher)(rt_uint8_t *frame_data, rt_size_t size, rt_uint32_t *key);
 	
-	rt_thread_t parser;	
+	/* unrequested frames in the parser, unconsumed responses in the request_end() caller, never overlapping */
 	void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size);
-    rt_timer_t send_interval_timer;
+	struct rt_mutex handler_lock;
+	const struct uart_stream_handler *stream_handler;
+	rt_size_t stream_len;
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+	struct rt_timer send_interval_timer;
+	rt_tick_t send_interval;		/* 0: no gap between requests */
+#endif
+	const struct uart_tx_crc *tx_crc;
+	const struct uart_tx_crc *rx_crc;
+	rt_bool_t rx_crc_drop;			/* drop bad frames instead of delivering them unstripped */
+	struct uart_rtt rtt;
+	struct uart_rtt *rtt_keys;		/* per matcher key estimates of async requests */
+	rt_size_t rtt_key_count;
+	rt_tick_t auto_timeout_min;
+	rt_bool_t auto_timeout;
+	struct uart_retry retry;
+#ifdef UART_CLIENT_USING_DE_PIN
+	rt_base_t de_pin;				/* RS485 driver enable, -1: none */
+	rt_uint8_t de_level;
+#ifdef RT_USING_HWTIMER
+	rt_device_t de_timer;			/* ends the turnaround, see uart_client_set_de_timer() */
+	struct rt_semaphore de_done;
+#endif
+#endif
+#ifdef PKG_UART_CLIENT_USING_CAPTURE
+	rt_bool_t capture;				/* see uart_capture_attach() */
+#endif
+	struct uart_tx_queue *tx_queue;
+	struct uart_client_stats stats;
+	rt_bool_t is_static;			/* set up by uart_client_init() */
+	void *pool_alloc;				/* heap frame pool after growing recv_buf_size */
 };
 typedef struct uart_client *uart_client_t;
 
+/* memory uart_client_init() needs for the frame pool of a client */
+#define UART_CLIENT_POOL_SIZE(recv_buf_size) \
+	(PKG_UART_CLIENT_FRAME_NUM * (RT_ALIGN((recv_buf_size), RT_ALIGN_SIZE) + sizeof(rt_uint8_t *)))
+
+/*
+ * Statically allocated client, e.g.
+ *     UART_CLIENT_STATIC_DEFINE(modbus, 256);
+ *     UART_CLIENT_STATIC_INIT(modbus, "uart2", 256, 10, 5, handler);
+ * then use &modbus as the client. Reactor mode needs no parser stack.
+ */
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+#define UART_CLIENT_STATIC_DEFINE(name, recv_buf_size) \
+	static struct uart_client name; \
+	ALIGN(RT_ALIGN_SIZE) static rt_uint8_t name##_pool[UART_CLIENT_POOL_SIZE(recv_buf_size)]
+#define UART_CLIENT_STATIC_INIT(name, dev_name, recv_buf_size, send_interval_ms, frame_timeout_ms, frame_handler) \
+	uart_client_init(&name, dev_name, name##_pool, sizeof(name##_pool), recv_buf_size, RT_NULL, 0, \
+			send_interval_ms, frame_timeout_ms, frame_handler)
+#else
+#define UART_CLIENT_STATIC_DEFINE(name, recv_buf_size) \
+	static struct uart_client name; \
+	ALIGN(RT_ALIGN_SIZE) static rt_uint8_t name##_pool[UART_CLIENT_POOL_SIZE(recv_buf_size)]; \
+	ALIGN(RT_ALIGN_SIZE) static rt_uint8_t name##_stack[PKG_UART_CLIENT_THREAD_STACK_SIZE]
+#define UART_CLIENT_STATIC_INIT(name, dev_name, recv_buf_size, send_interval_ms, frame_timeout_ms, frame_handler) \
+	uart_client_init(&name, dev_name, name##_pool, sizeof(name##_pool), recv_buf_size, name##_stack, \
+			sizeof(name##_stack), send_interval_ms, frame_timeout_ms, frame_handler)
+#endif
+
 uart_client_t uart_client_get_by_name(const char *dev_name);
+uart_client_t uart_client_get_by_device(rt_device_t dev);
 uart_client_t uart_client_create(const char *dev_name, rt_size_t recv_buf_size, rt_uint32_t send_interval_ms, rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size));
+rt_err_t uart_client_init(uart_client_t client, const char *dev_name, void *pool, rt_size_t pool_size, rt_size_t recv_buf_size, void *stack, rt_size_t stack_size, rt_uint32_t send_interval_ms, rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size));
+rt_err_t uart_client_delete(uart_client_t client);
+rt_err_t uart_client_detach(uart_client_t client);
+rt_err_t uart_client_reconfigure(uart_client_t client, rt_uint32_t baud_rate, rt_size_t recv_buf_size, rt_uint32_t frame_timeout_ms);
 rt_err_t uart_client_request_start(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf, rt_size_t req_size);
-rt_err_t uart_client_request_start_with_rs485(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf, rt_size_t req_size, void (*set_tx)(void), void (*set_rx)(void));
 void uart_client_request_end(uart_client_t client, rt_bool_t consume);
 rt_err_t uart_client_request_no_response(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size);
+rt_err_t uart_client_request_startv(uart_client_t client, rt_uint32_t timeout_ms, const struct uart_iovec *iov, int iovcnt);
+rt_err_t uart_client_request_no_responsev(uart_client_t client, const struct uart_iovec *iov, int iovcnt);
+#ifndef PKG_UART_CLIENT_WITHOUT_RS485
+/* set_tx/set_rx run around every write; prefer uart_client_set_rs485() where DE is a pin */
+rt_err_t uart_client_request_start_with_rs485(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf, rt_size_t req_size, void (*set_tx)(void), void (*set_rx)(void));
 rt_err_t uart_client_request_no_response_with_rs485(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size, void (*set_tx)(void), void (*set_rx)(void));
+rt_err_t uart_client_request_startv_with_rs485(uart_client_t client, rt_uint32_t timeout_ms, const struct uart_iovec *iov, int iovcnt, void (*set_tx)(void), void (*set_rx)(void));
+rt_err_t uart_client_request_no_responsev_with_rs485(uart_client_t client, const struct uart_iovec *iov, int iovcnt, void (*set_tx)(void), void (*set_rx)(void));
+#endif
+rt_err_t uart_client_request_batch(uart_client_t client, struct uart_batch_item *items, rt_size_t count);
+rt_err_t uart_client_request_batch_untimed(uart_client_t client, struct uart_batch_item *items, rt_size_t count);
+rt_err_t uart_client_transact(uart_client_t client, rt_uint32_t timeout_ms, const rt_uint8_t *req_buf, rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size, rt_size_t *resp_size);
+void uart_client_set_tx_crc(uart_client_t client, const struct uart_tx_crc *tx_crc);
+void uart_client_set_rx_crc(uart_client_t client, const struct uart_tx_crc *rx_crc, rt_bool_t drop_bad);
+#ifdef UART_CLIENT_USING_DE_PIN
+void uart_client_set_rs485(uart_client_t client, rt_base_t de_pin, rt_uint8_t de_level);
+#ifdef RT_USING_HWTIMER
+rt_err_t uart_client_set_de_timer(uart_client_t client, const char *timer_name);
+#endif
+#endif
+rt_err_t uart_client_tx_queue_create(uart_client_t client, rt_size_t msg_size, rt_size_t depth, enum uart_tx_overflow policy, rt_uint32_t block_ms);
+rt_err_t uart_client_request_enqueue(uart_client_t client, const rt_uint8_t *req_buf, rt_size_t req_size);
+void uart_client_tx_queue_stat(uart_client_t client, struct uart_tx_queue_stat *stat);
+void uart_client_set_matcher(uart_client_t client, rt_err_t (*matcher)(rt_uint8_t *frame_data, rt_size_t size, rt_uint32_t *key));
+rt_err_t uart_client_request_async(uart_client_t client, uart_transaction_t trans, rt_uint32_t key, rt_uint32_t timeout_ms, rt_uint8_t *req_buf, rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size);
+rt_err_t uart_client_request_wait(uart_client_t client, uart_transaction_t trans);
+rt_err_t uart_client_set_framing(uart_client_t client, const struct uart_frame_config *cfg);
 void uart_client_set_frame_handler(uart_client_t client, rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size));
+void uart_client_set_stream_handler(uart_client_t client, const struct uart_stream_handler *handler);
+#ifdef RT_USING_HWTIMER
+rt_err_t uart_client_set_gap_timer(uart_client_t client, const char *timer_name);
+#endif
+void uart_client_set_lanes(uart_client_t client, rt_uint8_t high_prio, rt_uint8_t bulk_prio, rt_bool_t preempt);
+void uart_client_set_auto_timeout(uart_client_t client, rt_bool_t enable, rt_uint32_t min_ms);
+void uart_client_set_rtt_keys(uart_client_t client, struct uart_rtt *table, rt_size_t count);
+void uart_client_set_retry(uart_client_t client, const struct uart_retry *retry);
+void uart_rtt_update(struct uart_rtt *rtt, rt_tick_t sample);
+void uart_rtt_backoff(struct uart_rtt *rtt);
+rt_tick_t uart_rtt_rto(const struct uart_rtt *rtt);
+void uart_client_get_stats(uart_client_t client, struct uart_client_stats *stats);
+void uart_client_reset_stats(uart_client_t client);
 
 #endif
 #endif
@@ -0,0 +1,104 @@
+#ifndef __UART_CLIENT_BUS_H__
+#define __UART_CLIENT_BUS_H__
+
+#include <rtthread.h>
+#include <uart_client.h>
+
+/* below the parser threads, so responses are taken while the next poll is built */
+#ifndef PKG_UART_CLIENT_BUS_PRIORITY
+#define PKG_UART_CLIENT_BUS_PRIORITY	(RT_THREAD_PRIORITY_MAX / 2)
+#endif
+
+/* due slaves polled back to back in one uart_client_request_batch() */
+#ifndef PKG_UART_CLIENT_BUS_BATCH
+#define PKG_UART_CLIENT_BUS_BATCH	8
+#endif
+
+/* consecutive failures before a slave is backed off */
+#ifndef PKG_UART_CLIENT_BUS_OFFLINE_FAILS
+#define PKG_UART_CLIENT_BUS_OFFLINE_FAILS	3
+#endif
+
+/* longest poll period of a backed off slave */
+#ifndef PKG_UART_CLIENT_BUS_BACKOFF_MAX_MS
+#define PKG_UART_CLIENT_BUS_BACKOFF_MAX_MS	10000
+#endif
+
+/* shortest adaptive timeout */
+#ifndef PKG_UART_CLIENT_BUS_MIN_TIMEOUT_MS
+#define PKG_UART_CLIENT_BUS_MIN_TIMEOUT_MS	5
+#endif
+
+/* poll flags */
+#define UART_BUS_MATCH_ADDRESS		0x01	/* the response must start with the slave address */
+
+/* one row of the poll table, copied by uart_bus_add() */
+struct uart_bus_poll
+{
+	rt_uint8_t address;
+	rt_uint8_t flags;
+	const rt_uint8_t *req_buf;		/* request template, must stay valid */
+	rt_size_t req_size;
+	rt_uint32_t period_ms;
+	rt_uint32_t deadline_ms;		/* lateness counted as a miss, 0: one period */
+	rt_uint32_t timeout_ms;			/* upper bound of the adaptive timeout */
+};
+
+struct uart_bus_stat
+{
+	rt_uint32_t polls;
+	rt_uint32_t responses;
+	rt_uint32_t timeouts;
+	rt_uint32_t mismatches;			/* responses from another address */
+	rt_uint32_t deadline_misses;
+	rt_uint32_t backoffs;			/* polls skipped while backed off */
+	rt_uint32_t rate_mhz;			/* responses per 1000 s since the last reset */
+	rt_uint32_t timeout_ms;			/* the adaptive timeout now */
+	rt_tick_t srtt;					/* smoothed response time */
+	rt_bool_t offline;
+};
+
+struct uart_bus_slave;
+typedef void (*uart_bus_handler_t)(struct uart_bus_slave *slave, rt_err_t result, rt_uint8_t *data, rt_size_t size);
+
+struct uart_bus_slave
+{
+	rt_list_t list;
+	struct uart_bus_poll poll;
+	rt_uint8_t *resp_buf;
+	rt_size_t resp_buf_size;
+	uart_bus_handler_t handler;
+	void *user_data;
+	rt_tick_t next_due;
+	struct uart_rtt rtt;			/* no sample yet: the full timeout applies */
+	rt_uint16_t fail_streak;
+	struct uart_bus_stat stat;
+	rt_tick_t stat_since;
+};
+
+struct uart_bus
+{
+	uart_client_t client;
+	rt_list_t slaves;
+	struct rt_mutex lock;
+	struct rt_semaphore wake;
+	struct rt_semaphore done;
+	struct rt_semaphore round;		/* released for every remover once a batch is completed */
+	rt_uint16_t round_waiters;
+	rt_size_t polling;				/* slaves of batch on the wire, 0 between rounds */
+	rt_thread_t thread;
+	volatile rt_bool_t stopping;
+	struct uart_bus_slave *batch[PKG_UART_CLIENT_BUS_BATCH];
+	struct uart_batch_item items[PKG_UART_CLIENT_BUS_BATCH];
+};
+typedef struct uart_bus *uart_bus_t;
+
+uart_bus_t uart_bus_create(uart_client_t client);
+void uart_bus_delete(uart_bus_t bus);
+rt_err_t uart_bus_add(uart_bus_t bus, struct uart_bus_slave *slave, const struct uart_bus_poll *poll,
+		rt_uint8_t *resp_buf, rt_size_t resp_buf_size, uart_bus_handler_t handler);
+void uart_bus_remove(uart_bus_t bus, struct uart_bus_slave *slave);
+void uart_bus_get_stat(uart_bus_t bus, struct uart_bus_slave *slave, struct uart_bus_stat *stat);
+void uart_bus_reset_stat(uart_bus_t bus, struct uart_bus_slave *slave);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __UART_CLIENT_CACHE_H__
+#define __UART_CLIENT_CACHE_H__
+
+#include <rtthread.h>
+#include <uart_client.h>
+
+struct uart_cache_stats
+{
+	rt_uint32_t hits;				/* answered from a stored response */
+	rt_uint32_t misses;				/* sent on the wire */
+	rt_uint32_t collapsed;			/* joined an identical request in flight */
+	rt_uint32_t bypassed;			/* sent without caching, every entry busy or too large */
+};
+
+/* key of a request, requests with equal keys are answered alike; RT_NULL compares the bytes */
+typedef rt_uint32_t (*uart_cache_key_t)(const rt_uint8_t *req_buf, rt_size_t req_size);
+
+struct uart_cache_entry
+{
+	rt_uint32_t key;
+	rt_uint8_t state;
+	rt_uint16_t waiters;			/* collapsed requests still to copy the response */
+	rt_tick_t filled;				/* when the response was stored */
+	rt_size_t req_size;
+	rt_size_t resp_size;
+	rt_err_t result;
+	struct rt_semaphore done;
+	rt_uint8_t *req;
+	rt_uint8_t *resp;
+};
+
+struct uart_cache
+{
+	uart_client_t client;
+	struct rt_mutex lock;
+	uart_cache_key_t key;
+	rt_size_t count;
+	rt_size_t req_max;
+	rt_size_t resp_max;
+	struct uart_cache_stats stats;
+	struct uart_cache_entry entries[];
+};
+typedef struct uart_cache *uart_cache_t;
+
+uart_cache_t uart_cache_create(uart_client_t client, rt_size_t count, rt_size_t req_max, rt_size_t resp_max,
+		uart_cache_key_t key);
+void uart_cache_delete(uart_cache_t cache);
+rt_err_t uart_cache_transact(uart_cache_t cache, rt_uint32_t ttl_ms, rt_uint32_t timeout_ms, const rt_uint8_t *req_buf,
+		rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size, rt_size_t *resp_size);
+void uart_cache_invalidate(uart_cache_t cache);
+void uart_cache_get_stats(uart_cache_t cache, struct uart_cache_stats *stats);
+void uart_cache_reset_stats(uart_cache_t cache);
+
+#endif
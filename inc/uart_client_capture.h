@@ -0,0 +1,94 @@
+#ifndef __UART_CLIENT_CAPTURE_H__
+#define __UART_CLIENT_CAPTURE_H__
+
+#include <rtthread.h>
+#include <uart_client.h>
+
+/* the background writer drains the ring this often, or sooner once it is half full */
+#ifndef PKG_UART_CLIENT_CAPTURE_FLUSH_MS
+#define PKG_UART_CLIENT_CAPTURE_FLUSH_MS	100
+#endif
+
+#ifndef PKG_UART_CLIENT_CAPTURE_PRIORITY
+#define PKG_UART_CLIENT_CAPTURE_PRIORITY	(RT_THREAD_PRIORITY_MAX - 2)
+#endif
+
+/*
+ * Capture stream: one uart_capture_header, then records back to back without
+ * padding, each a uart_capture_record followed by len data bytes. Fields are
+ * in the byte order of the target.
+ */
+#define UART_CAPTURE_MAGIC		"UCAP"
+#define UART_CAPTURE_VERSION	1
+
+struct uart_capture_header
+{
+	rt_uint8_t magic[4];
+	rt_uint8_t version;
+	rt_uint8_t header_size;			/* sizeof(struct uart_capture_header) */
+	rt_uint8_t record_size;			/* sizeof(struct uart_capture_record) */
+	rt_uint8_t reserved;
+};
+
+enum uart_capture_type
+{
+	UART_CAPTURE_RX = 0,			/* bytes as one rt_device_read() returned them */
+	UART_CAPTURE_TX,				/* one request as written, CRC trailer included */
+	UART_CAPTURE_LOST,				/* 4 bytes: records dropped on a full ring since the last one */
+};
+
+struct uart_capture_record
+{
+	rt_uint32_t time_us;			/* capture clock, wraps */
+	rt_uint16_t len;
+	rt_uint8_t type;
+	rt_uint8_t channel;				/* client index */
+};
+
+struct uart_capture_stat
+{
+	rt_uint32_t records;
+	rt_uint32_t bytes;				/* record data bytes */
+	rt_uint32_t dropped;
+	rt_size_t used;
+	rt_size_t used_max;
+	rt_size_t size;
+};
+
+enum uart_replay_speed
+{
+	UART_REPLAY_REALTIME = 0,		/* keep the recorded gaps */
+	UART_REPLAY_MAX,				/* as fast as the client drains the device */
+};
+
+/* a reserved ring area, filled by uart_capture_append() */
+struct uart_capture_slot
+{
+	rt_uint32_t start;
+	rt_uint32_t pos;
+};
+
+/* returns the bytes taken, less than size stops the capture */
+typedef rt_size_t (*uart_capture_sink_t)(void *ctx, const void *buf, rt_size_t size);
+
+rt_err_t uart_capture_start(rt_size_t ring_size, uart_capture_sink_t sink, void *ctx);
+#ifdef RT_USING_DFS
+rt_err_t uart_capture_start_file(const char *path, rt_size_t ring_size);
+#endif
+void uart_capture_stop(void);
+void uart_capture_attach(uart_client_t client, rt_bool_t enable);
+rt_size_t uart_capture_read(void *buf, rt_size_t size);
+void uart_capture_set_clock(rt_uint32_t (*clock_us)(void));
+void uart_capture_get_stat(struct uart_capture_stat *stat);
+
+/* the tap in uart_client.c */
+rt_bool_t uart_capture_begin(uart_client_t client, enum uart_capture_type type, rt_size_t len,
+		struct uart_capture_slot *slot);
+void uart_capture_append(struct uart_capture_slot *slot, const void *data, rt_size_t len);
+void uart_capture_commit(struct uart_capture_slot *slot);
+
+rt_err_t uart_replay_device_register(const char *name, rt_size_t ring_size);
+rt_err_t uart_replay(const char *dev_name, const void *capture, rt_size_t size, int channel,
+		enum uart_replay_speed speed);
+
+#endif
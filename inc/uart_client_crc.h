@@ -0,0 +1,38 @@
+#ifndef __UART_CLIENT_CRC_H__
+#define __UART_CLIENT_CRC_H__
+
+#include <rtthread.h>
+#include <uart_client.h>
+
+/* table kernels keep PKG_UART_CLIENT_CRC_SLICES x 256 words per engine in use: 1, 4 or 8 */
+#ifndef PKG_UART_CLIENT_CRC_SLICES
+#define PKG_UART_CLIENT_CRC_SLICES	1
+#endif
+
+enum uart_crc_type
+{
+	UART_CRC16_MODBUS = 0,		/* poly 0x8005 reflected, init 0xFFFF, low byte first */
+	UART_CRC16_CCITT,			/* poly 0x1021, init 0xFFFF (CCITT-FALSE), high byte first */
+	UART_CRC32,					/* IEEE 802.3, low byte first */
+	UART_CHECKSUM_SUM8,			/* byte sum modulo 256 */
+	UART_CHECKSUM_XOR8,			/* xor of all bytes */
+	UART_CRC_TYPE_NUM,
+};
+
+enum uart_crc_kernel
+{
+	UART_CRC_KERNEL_BITWISE = 0,
+	UART_CRC_KERNEL_TABLE,		/* one lookup per byte */
+	UART_CRC_KERNEL_SLICE4,
+	UART_CRC_KERNEL_SLICE8,
+	UART_CRC_KERNEL_NUM,
+};
+
+typedef rt_uint32_t (*uart_crc_update_t)(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size);
+
+const struct uart_tx_crc *uart_crc_get(enum uart_crc_type type);
+void uart_crc_set_update(enum uart_crc_type type, uart_crc_update_t update);
+uart_crc_update_t uart_crc_kernel(enum uart_crc_type type, enum uart_crc_kernel kernel);
+rt_uint32_t uart_crc_calc(const struct uart_tx_crc *crc, const rt_uint8_t *data, rt_size_t size);
+
+#endif
@@ -0,0 +1,7 @@
+/*
+ * Board definitions for the POSIX host shim.
+ */
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#endif
@@ -0,0 +1,1252 @@
+/*
+ * POSIX implementation of the RT-Thread kernel services used by uart_client.
+ */
+#define _GNU_SOURCE
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <rthw.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* interrupt lock: one recursive mutex shared by all "ISRs" and critical sections */
+static pthread_mutex_t irq_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static rt_size_t heap_used, heap_max_used;
+
+void rt_hw_assert_failed(void)
+{
+    abort();
+}
+
+int rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vprintf(fmt, args);
+    va_end(args);
+    fflush(stdout);
+    return len;
+}
+
+int __rt_ffs(int value)
+{
+    return __builtin_ffs(value);
+}
+
+void *rt_malloc(rt_size_t size)
+{
+    rt_size_t *ptr = malloc(size + RT_ALIGN_SIZE);
+
+    if (ptr == RT_NULL)
+        return RT_NULL;
+    ptr[0] = size;
+    pthread_mutex_lock(&heap_lock);
+    heap_used += size;
+    if (heap_used > heap_max_used)
+        heap_max_used = heap_used;
+    pthread_mutex_unlock(&heap_lock);
+    return (rt_uint8_t *) ptr + RT_ALIGN_SIZE;
+}
+
+void *rt_calloc(rt_size_t count, rt_size_t size)
+{
+    void *ptr = rt_malloc(count * size);
+
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void rt_free(void *ptr)
+{
+    rt_size_t *hdr;
+
+    if (ptr == RT_NULL)
+        return;
+    hdr = (rt_size_t *) ((rt_uint8_t *) ptr - RT_ALIGN_SIZE);
+    pthread_mutex_lock(&heap_lock);
+    heap_used -= hdr[0];
+    pthread_mutex_unlock(&heap_lock);
+    free(hdr);
+}
+
+void rt_memory_info(rt_size_t *total, rt_size_t *used, rt_size_t *max_used)
+{
+    pthread_mutex_lock(&heap_lock);
+    if (total)
+        *total = 0;
+    if (used)
+        *used = heap_used;
+    if (max_used)
+        *max_used = heap_max_used;
+    pthread_mutex_unlock(&heap_lock);
+}
+
+static rt_uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (rt_uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+rt_tick_t rt_tick_get(void)
+{
+    return (rt_tick_t) (now_us() / (1000000 / RT_TICK_PER_SECOND));
+}
+
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms)
+{
+    if (ms < 0)
+        return (rt_tick_t) RT_WAITING_FOREVER;
+    return (rt_tick_t) (((rt_uint64_t) ms * RT_TICK_PER_SECOND + 999) / 1000);
+}
+
+void rt_hw_us_delay(rt_uint32_t us)
+{
+    rt_uint64_t end = now_us() + us;
+
+    while (now_us() < end)
+        ;
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    RT_UNUSED(level);
+    pthread_mutex_unlock(&irq_lock);
+}
+
+void rt_enter_critical(void)
+{
+    pthread_mutex_lock(&irq_lock);
+}
+
+void rt_exit_critical(void)
+{
+    pthread_mutex_unlock(&irq_lock);
+}
+
+static void object_init(struct rt_object *obj, const char *name)
+{
+    memset(obj->name, 0, sizeof(obj->name));
+    if (name)
+        strncpy(obj->name, name, RT_NAME_MAX - 1);
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void cond_wait_cleanup(void *mtx)
+{
+    pthread_mutex_unlock(mtx);
+}
+
+/*
+ * Wait on cond until woken or the tick timeout expires, returns 0 or ETIMEDOUT.
+ * This is where rt_thread_detach() stops a blocked thread, mtx is dropped then.
+ */
+static int cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *mtx, const struct timespec *deadline)
+{
+    int result, state;
+
+    pthread_cleanup_push(cond_wait_cleanup, mtx);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
+    if (deadline == RT_NULL)
+        result = pthread_cond_wait(cond, mtx);
+    else
+        result = pthread_cond_timedwait(cond, mtx, deadline);
+    pthread_setcancelstate(state, RT_NULL);
+    pthread_cleanup_pop(0);
+    return result;
+}
+
+static struct timespec *deadline_from_ticks(struct timespec *ts, rt_int32_t timeout)
+{
+    rt_uint64_t ns;
+
+    if (timeout < 0)
+        return RT_NULL;
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ns = (rt_uint64_t) ts->tv_nsec + (rt_uint64_t) timeout * (1000000000ULL / RT_TICK_PER_SECOND);
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+    return ts;
+}
+
+/* semaphore */
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    RT_UNUSED(flag);
+    object_init(&sem->parent, name);
+    pthread_mutex_init(&sem->mtx, RT_NULL);
+    cond_init(&sem->cond);
+    sem->value = value;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mtx);
+    return RT_EOK;
+}
+
+rt_sem_t rt_sem_create(const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    rt_sem_t sem = rt_calloc(1, sizeof(struct rt_semaphore));
+
+    if (sem)
+        rt_sem_init(sem, name, value, flag);
+    return sem;
+}
+
+rt_err_t rt_sem_delete(rt_sem_t sem)
+{
+    rt_sem_detach(sem);
+    rt_free(sem);
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t timeout)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, timeout);
+    rt_err_t result = RT_EOK;
+
+    pthread_mutex_lock(&sem->mtx);
+    while (sem->value == 0)
+    {
+        if (timeout == 0 || cond_wait_ticks(&sem->cond, &sem->mtx, deadline) == ETIMEDOUT)
+        {
+            if (sem->value == 0)
+            {
+                result = -RT_ETIMEOUT;
+                break;
+            }
+        }
+    }
+    if (result == RT_EOK)
+        sem->value--;
+    pthread_mutex_unlock(&sem->mtx);
+    return result;
+}
+
+rt_err_t rt_sem_trytake(rt_sem_t sem)
+{
+    return rt_sem_take(sem, 0);
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    pthread_mutex_lock(&sem->mtx);
+    if (sem->value < 0xFFFF)
+        sem->value++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mtx);
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg)
+{
+    if (cmd == RT_IPC_CMD_RESET)
+    {
+        pthread_mutex_lock(&sem->mtx);
+        sem->value = (rt_uint16_t) (rt_ubase_t) arg;
+        pthread_mutex_unlock(&sem->mtx);
+        return RT_EOK;
+    }
+    return -RT_ERROR;
+}
+
+/* mutex: recursive, built on a condition variable so a waiting thread can be detached */
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
+{
+    RT_UNUSED(flag);
+    object_init(&mutex->parent, name);
+    pthread_mutex_init(&mutex->mtx, RT_NULL);
+    cond_init(&mutex->cond);
+    mutex->hold = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_detach(rt_mutex_t mutex)
+{
+    pthread_cond_destroy(&mutex->cond);
+    pthread_mutex_destroy(&mutex->mtx);
+    return RT_EOK;
+}
+
+rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
+{
+    rt_mutex_t mutex = rt_calloc(1, sizeof(struct rt_mutex));
+
+    if (mutex)
+        rt_mutex_init(mutex, name, flag);
+    return mutex;
+}
+
+rt_err_t rt_mutex_delete(rt_mutex_t mutex)
+{
+    rt_mutex_detach(mutex);
+    rt_free(mutex);
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t timeout)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, timeout);
+    rt_err_t result = RT_EOK;
+
+    pthread_mutex_lock(&mutex->mtx);
+    while (mutex->hold > 0 && !pthread_equal(mutex->owner, pthread_self()))
+    {
+        if (timeout == 0 || cond_wait_ticks(&mutex->cond, &mutex->mtx, deadline) == ETIMEDOUT)
+        {
+            if (mutex->hold > 0 && !pthread_equal(mutex->owner, pthread_self()))
+            {
+                result = -RT_ETIMEOUT;
+                break;
+            }
+        }
+    }
+    if (result == RT_EOK)
+    {
+        mutex->owner = pthread_self();
+        mutex->hold++;
+    }
+    pthread_mutex_unlock(&mutex->mtx);
+    return result;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    rt_err_t result = RT_EOK;
+
+    pthread_mutex_lock(&mutex->mtx);
+    if (mutex->hold == 0 || !pthread_equal(mutex->owner, pthread_self()))
+        result = -RT_ERROR;
+    else if (--mutex->hold == 0)
+        pthread_cond_signal(&mutex->cond);
+    pthread_mutex_unlock(&mutex->mtx);
+    return result;
+}
+
+/* event */
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag)
+{
+    RT_UNUSED(flag);
+    object_init(&event->parent, name);
+    pthread_mutex_init(&event->mtx, RT_NULL);
+    cond_init(&event->cond);
+    event->set = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_event_detach(rt_event_t event)
+{
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->mtx);
+    return RT_EOK;
+}
+
+rt_event_t rt_event_create(const char *name, rt_uint8_t flag)
+{
+    rt_event_t event = rt_calloc(1, sizeof(struct rt_event));
+
+    if (event)
+        rt_event_init(event, name, flag);
+    return event;
+}
+
+rt_err_t rt_event_delete(rt_event_t event)
+{
+    rt_event_detach(event);
+    rt_free(event);
+    return RT_EOK;
+}
+
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
+{
+    pthread_mutex_lock(&event->mtx);
+    event->set |= set;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->mtx);
+    return RT_EOK;
+}
+
+static rt_bool_t event_match(rt_event_t event, rt_uint32_t set, rt_uint8_t opt)
+{
+    if (opt & RT_EVENT_FLAG_AND)
+        return (event->set & set) == set;
+    return (event->set & set) != 0;
+}
+
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t opt, rt_int32_t timeout, rt_uint32_t *recved)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, timeout);
+    rt_err_t result = RT_EOK;
+
+    pthread_mutex_lock(&event->mtx);
+    while (!event_match(event, set, opt))
+    {
+        if (timeout == 0 || cond_wait_ticks(&event->cond, &event->mtx, deadline) == ETIMEDOUT)
+        {
+            if (!event_match(event, set, opt))
+            {
+                result = -RT_ETIMEOUT;
+                break;
+            }
+        }
+    }
+    if (result == RT_EOK)
+    {
+        if (recved)
+            *recved = event->set & set;
+        if (opt & RT_EVENT_FLAG_CLEAR)
+            event->set &= ~set;
+    }
+    pthread_mutex_unlock(&event->mtx);
+    return result;
+}
+
+/* mailbox */
+rt_err_t rt_mb_init(rt_mailbox_t mb, const char *name, void *msgpool, rt_size_t size, rt_uint8_t flag)
+{
+    RT_UNUSED(flag);
+    object_init(&mb->parent, name);
+    pthread_mutex_init(&mb->mtx, RT_NULL);
+    cond_init(&mb->cond);
+    mb->msg_pool = msgpool;
+    mb->size = size;
+    mb->entry = mb->in_offset = mb->out_offset = 0;
+    mb->allocated = RT_FALSE;
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_detach(rt_mailbox_t mb)
+{
+    pthread_cond_destroy(&mb->cond);
+    pthread_mutex_destroy(&mb->mtx);
+    return RT_EOK;
+}
+
+rt_mailbox_t rt_mb_create(const char *name, rt_size_t size, rt_uint8_t flag)
+{
+    rt_mailbox_t mb = rt_calloc(1, sizeof(struct rt_mailbox));
+
+    if (mb == RT_NULL)
+        return RT_NULL;
+    rt_mb_init(mb, name, rt_calloc(size, sizeof(rt_ubase_t)), size, flag);
+    mb->allocated = RT_TRUE;
+    return mb;
+}
+
+rt_err_t rt_mb_delete(rt_mailbox_t mb)
+{
+    rt_mb_detach(mb);
+    rt_free(mb->msg_pool);
+    rt_free(mb);
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_send_wait(rt_mailbox_t mb, rt_ubase_t value, rt_int32_t timeout)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, timeout);
+
+    pthread_mutex_lock(&mb->mtx);
+    while (mb->entry == mb->size)
+    {
+        if (timeout == 0 || cond_wait_ticks(&mb->cond, &mb->mtx, deadline) == ETIMEDOUT)
+        {
+            if (mb->entry == mb->size)
+            {
+                pthread_mutex_unlock(&mb->mtx);
+                return timeout == 0 ? -RT_EFULL : -RT_ETIMEOUT;
+            }
+        }
+    }
+    mb->msg_pool[mb->in_offset] = value;
+    mb->in_offset = (mb->in_offset + 1) % mb->size;
+    mb->entry++;
+    pthread_cond_broadcast(&mb->cond);
+    pthread_mutex_unlock(&mb->mtx);
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_send(rt_mailbox_t mb, rt_ubase_t value)
+{
+    return rt_mb_send_wait(mb, value, 0);
+}
+
+rt_err_t rt_mb_recv(rt_mailbox_t mb, rt_ubase_t *value, rt_int32_t timeout)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, timeout);
+
+    pthread_mutex_lock(&mb->mtx);
+    while (mb->entry == 0)
+    {
+        if (timeout == 0 || cond_wait_ticks(&mb->cond, &mb->mtx, deadline) == ETIMEDOUT)
+        {
+            if (mb->entry == 0)
+            {
+                pthread_mutex_unlock(&mb->mtx);
+                return -RT_ETIMEOUT;
+            }
+        }
+    }
+    *value = mb->msg_pool[mb->out_offset];
+    mb->out_offset = (mb->out_offset + 1) % mb->size;
+    mb->entry--;
+    pthread_cond_broadcast(&mb->cond);
+    pthread_mutex_unlock(&mb->mtx);
+    return RT_EOK;
+}
+
+/* memory pool: each block is preceded by a pointer to its pool, as in the kernel */
+rt_err_t rt_mp_init(rt_mp_t mp, const char *name, void *start, rt_size_t size, rt_size_t block_size)
+{
+    rt_size_t offset;
+    rt_uint8_t *block;
+
+    object_init(&mp->parent, name);
+    pthread_mutex_init(&mp->mtx, RT_NULL);
+    cond_init(&mp->cond);
+    mp->start_address = start;
+    mp->size = size;
+    mp->block_size = RT_ALIGN(block_size, RT_ALIGN_SIZE);
+    mp->block_total_count = size / (mp->block_size + sizeof(rt_uint8_t *));
+    mp->block_free_count = mp->block_total_count;
+    mp->block_list = RT_NULL;
+    mp->allocated = RT_FALSE;
+    for (offset = 0; offset < mp->block_total_count; offset++)
+    {
+        block = (rt_uint8_t *) start + offset * (mp->block_size + sizeof(rt_uint8_t *));
+        *(rt_uint8_t **) block = mp->block_list;
+        mp->block_list = block;
+    }
+    return RT_EOK;
+}
+
+rt_err_t rt_mp_detach(rt_mp_t mp)
+{
+    pthread_cond_destroy(&mp->cond);
+    pthread_mutex_destroy(&mp->mtx);
+    return RT_EOK;
+}
+
+rt_mp_t rt_mp_create(const char *name, rt_size_t block_count, rt_size_t block_size)
+{
+    rt_mp_t mp = rt_calloc(1, sizeof(struct rt_mempool));
+    rt_size_t size;
+    void *start;
+
+    if (mp == RT_NULL)
+        return RT_NULL;
+    size = (RT_ALIGN(block_size, RT_ALIGN_SIZE) + sizeof(rt_uint8_t *)) * block_count;
+    start = rt_malloc(size);
+    if (start == RT_NULL)
+    {
+        rt_free(mp);
+        return RT_NULL;
+    }
+    rt_mp_init(mp, name, start, size, block_size);
+    mp->allocated = RT_TRUE;
+    return mp;
+}
+
+rt_err_t rt_mp_delete(rt_mp_t mp)
+{
+    rt_mp_detach(mp);
+    rt_free(mp->start_address);
+    rt_free(mp);
+    return RT_EOK;
+}
+
+void *rt_mp_alloc(rt_mp_t mp, rt_int32_t time)
+{
+    struct timespec ts, *deadline = deadline_from_ticks(&ts, time);
+    rt_uint8_t *block;
+
+    pthread_mutex_lock(&mp->mtx);
+    while (mp->block_list == RT_NULL)
+    {
+        if (time == 0 || cond_wait_ticks(&mp->cond, &mp->mtx, deadline) == ETIMEDOUT)
+        {
+            if (mp->block_list == RT_NULL)
+            {
+                pthread_mutex_unlock(&mp->mtx);
+                return RT_NULL;
+            }
+        }
+    }
+    block = mp->block_list;
+    mp->block_list = *(rt_uint8_t **) block;
+    mp->block_free_count--;
+    *(rt_mp_t *) block = mp;
+    pthread_mutex_unlock(&mp->mtx);
+    return block + sizeof(rt_uint8_t *);
+}
+
+void rt_mp_free(void *ptr)
+{
+    rt_uint8_t *block = (rt_uint8_t *) ptr - sizeof(rt_uint8_t *);
+    rt_mp_t mp = *(rt_mp_t *) block;
+
+    pthread_mutex_lock(&mp->mtx);
+    *(rt_uint8_t **) block = mp->block_list;
+    mp->block_list = block;
+    mp->block_free_count++;
+    pthread_cond_signal(&mp->cond);
+    pthread_mutex_unlock(&mp->mtx);
+}
+
+/* timers run from one soft-timer thread, scanned every tick */
+static rt_list_t timer_list = RT_LIST_OBJECT_INIT(timer_list);
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+
+static void *timer_thread_entry(void *arg)
+{
+    rt_list_t *node;
+    rt_timer_t timer;
+
+    RT_UNUSED(arg);
+    while (1)
+    {
+        usleep(1000000 / RT_TICK_PER_SECOND / 2);
+        pthread_mutex_lock(&timer_lock);
+        for (node = timer_list.next; node != &timer_list; )
+        {
+            timer = rt_list_entry(node, struct rt_timer, row);
+            node = node->next;
+            if ((rt_int32_t) (rt_tick_get() - timer->timeout_tick) >= 0)
+            {
+                if (timer->parent.flag & RT_TIMER_FLAG_PERIODIC)
+                {
+                    timer->timeout_tick = rt_tick_get() + timer->init_tick;
+                }
+                else
+                {
+                    rt_list_remove(&timer->row);
+                    timer->active = RT_FALSE;
+                }
+                pthread_mutex_unlock(&timer_lock);
+                timer->timeout_func(timer->parameter);
+                pthread_mutex_lock(&timer_lock);
+                node = timer_list.next;
+            }
+        }
+        pthread_mutex_unlock(&timer_lock);
+    }
+    return RT_NULL;
+}
+
+static void timer_system_init(void)
+{
+    pthread_t tid;
+
+    pthread_create(&tid, RT_NULL, timer_thread_entry, RT_NULL);
+    pthread_detach(tid);
+}
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter,
+        rt_tick_t time, rt_uint8_t flag)
+{
+    pthread_once(&timer_once, timer_system_init);
+    object_init(&timer->parent, name);
+    timer->parent.flag = flag;
+    rt_list_init(&timer->row);
+    timer->timeout_func = timeout;
+    timer->parameter = parameter;
+    timer->init_tick = time;
+    timer->active = RT_FALSE;
+    timer->allocated = RT_FALSE;
+}
+
+rt_err_t rt_timer_detach(rt_timer_t timer)
+{
+    rt_timer_stop(timer);
+    return RT_EOK;
+}
+
+rt_timer_t rt_timer_create(const char *name, void (*timeout)(void *parameter), void *parameter,
+        rt_tick_t time, rt_uint8_t flag)
+{
+    rt_timer_t timer = rt_calloc(1, sizeof(struct rt_timer));
+
+    if (timer)
+    {
+        rt_timer_init(timer, name, timeout, parameter, time, flag);
+        timer->allocated = RT_TRUE;
+    }
+    return timer;
+}
+
+rt_err_t rt_timer_delete(rt_timer_t timer)
+{
+    rt_timer_stop(timer);
+    rt_free(timer);
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_start(rt_timer_t timer)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (timer->active)
+        rt_list_remove(&timer->row);
+    timer->timeout_tick = rt_tick_get() + timer->init_tick;
+    timer->active = RT_TRUE;
+    rt_list_insert_before(&timer_list, &timer->row);
+    pthread_mutex_unlock(&timer_lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_stop(rt_timer_t timer)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (timer->active)
+    {
+        rt_list_remove(&timer->row);
+        timer->active = RT_FALSE;
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (cmd == RT_TIMER_CTRL_SET_TIME)
+        timer->init_tick = *(rt_tick_t *) arg;
+    else if (cmd == RT_TIMER_CTRL_GET_TIME)
+        *(rt_tick_t *) arg = timer->init_tick;
+    pthread_mutex_unlock(&timer_lock);
+    return RT_EOK;
+}
+
+/* threads */
+static __thread rt_thread_t current_thread;
+
+static void *thread_entry(void *arg)
+{
+    rt_thread_t thread = arg;
+
+    /* only the kernel waits are cancellation points, see rt_thread_detach() */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, RT_NULL);
+    current_thread = thread;
+    thread->entry(thread->parameter);
+    return RT_NULL;
+}
+
+rt_err_t rt_thread_init(struct rt_thread *thread, const char *name, void (*entry)(void *parameter), void *parameter,
+        void *stack_start, rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    RT_UNUSED(tick);
+    memset(thread, 0, sizeof(*thread));
+    strncpy(thread->name, name, RT_NAME_MAX - 1);
+    thread->entry = entry;
+    thread->parameter = parameter;
+    thread->stack_addr = stack_start;
+    thread->stack_size = stack_size;
+    thread->current_priority = priority;
+    thread->init_priority = priority;
+    return RT_EOK;
+}
+
+/*
+ * Another thread is stopped at its next blocking wait and reaped before this
+ * returns; a thread detaching itself keeps running until its entry returns.
+ */
+rt_err_t rt_thread_detach(rt_thread_t thread)
+{
+    if (!thread->started)
+        return RT_EOK;
+    if (pthread_equal(thread->tid, pthread_self()))
+    {
+        pthread_detach(thread->tid);
+        return RT_EOK;
+    }
+    pthread_cancel(thread->tid);
+    pthread_join(thread->tid, RT_NULL);
+    thread->started = RT_FALSE;
+    return RT_EOK;
+}
+
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+        rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    rt_thread_t thread = rt_malloc(sizeof(struct rt_thread) + stack_size);
+
+    if (thread)
+    {
+        rt_thread_init(thread, name, entry, parameter, thread + 1, stack_size, priority, tick);
+        thread->allocated = RT_TRUE;
+    }
+    return thread;
+}
+
+rt_err_t rt_thread_delete(rt_thread_t thread)
+{
+    rt_thread_detach(thread);
+    /* a thread deleting itself is still running on its control block, keep it */
+    if (!thread->started)
+        rt_free(thread);
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    thread->started = RT_TRUE;
+    return pthread_create(&thread->tid, RT_NULL, thread_entry, thread) == 0 ? RT_EOK : -RT_ERROR;
+}
+
+rt_thread_t rt_thread_self(void)
+{
+    /* host threads not started through the kernel get a control block of their own */
+    static __thread struct rt_thread foreign;
+
+    if (current_thread == RT_NULL)
+    {
+        rt_strncpy(foreign.name, "host", RT_NAME_MAX);
+        foreign.tid = pthread_self();
+        foreign.current_priority = RT_THREAD_PRIORITY_MAX / 2;
+        foreign.init_priority = foreign.current_priority;
+        foreign.started = RT_TRUE;
+        current_thread = &foreign;
+    }
+    return current_thread;
+}
+
+/* priorities are only recorded, the host scheduler does not honour them */
+rt_err_t rt_thread_control(rt_thread_t thread, int cmd, void *arg)
+{
+    if (cmd == RT_THREAD_CTRL_CHANGE_PRIORITY)
+    {
+        thread->current_priority = *(rt_uint8_t *) arg;
+        return RT_EOK;
+    }
+    return -RT_ENOSYS;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    usleep((useconds_t) tick * (1000000 / RT_TICK_PER_SECOND));
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_mdelay(rt_int32_t ms)
+{
+    return rt_thread_delay(rt_tick_from_millisecond(ms));
+}
+
+/* device registry */
+#define DEVICE_MAX  64
+static rt_device_t device_table[DEVICE_MAX];
+
+rt_device_t rt_device_find(const char *name)
+{
+    for (int i = 0; i < DEVICE_MAX; i++)
+    {
+        if (device_table[i] && strcmp(device_table[i]->parent.name, name) == 0)
+            return device_table[i];
+    }
+    return RT_NULL;
+}
+
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    for (int i = 0; i < DEVICE_MAX; i++)
+    {
+        if (device_table[i] == RT_NULL)
+        {
+            object_init(&dev->parent, name);
+            dev->flag = flags;
+            device_table[i] = dev;
+            return RT_EOK;
+        }
+    }
+    return -RT_EFULL;
+}
+
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    rt_err_t result = RT_EOK;
+
+    if ((oflag & RT_DEVICE_FLAG_DMA_RX) && !(dev->flag & RT_DEVICE_FLAG_DMA_RX))
+        return -RT_EIO;
+    if (dev->ops->open)
+        result = dev->ops->open(dev, oflag);
+    if (result == RT_EOK)
+    {
+        dev->open_flag = oflag;
+        dev->ref_count++;
+    }
+    return result;
+}
+
+rt_err_t rt_device_close(rt_device_t dev)
+{
+    if (dev->ref_count == 0)
+        return -RT_ERROR;
+    if (--dev->ref_count == 0 && dev->ops->close)
+        dev->ops->close(dev);
+    return RT_EOK;
+}
+
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    return dev->ops->read ? dev->ops->read(dev, pos, buffer, size) : 0;
+}
+
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return dev->ops->write ? dev->ops->write(dev, pos, buffer, size) : 0;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    return dev->ops->control ? dev->ops->control(dev, cmd, arg) : -RT_ENOSYS;
+}
+
+rt_err_t rt_device_set_rx_indicate(rt_device_t dev, rt_err_t (*rx_ind)(rt_device_t dev, rt_size_t size))
+{
+    dev->rx_indicate = rx_ind;
+    return RT_EOK;
+}
+
+rt_err_t rt_device_set_tx_complete(rt_device_t dev, rt_err_t (*tx_done)(rt_device_t dev, void *buffer))
+{
+    dev->tx_complete = tx_done;
+    return RT_EOK;
+}
+
+/* pins only record their level */
+static rt_uint8_t pin_level[256];
+
+void rt_pin_mode(rt_base_t pin, rt_uint8_t mode)
+{
+    RT_UNUSED(pin);
+    RT_UNUSED(mode);
+}
+
+void rt_pin_write(rt_base_t pin, rt_uint8_t value)
+{
+    pin_level[pin & 0xFF] = value;
+}
+
+int rt_pin_read(rt_base_t pin)
+{
+    return pin_level[pin & 0xFF];
+}
+
+/* simulated serial device */
+struct sim_serial
+{
+    struct rt_serial_device serial;
+    rt_uint8_t *rx_buf;
+    rt_size_t rx_bufsz;
+    rt_size_t rx_head;
+    rt_size_t rx_tail;
+    rt_size_t rx_count;
+    rt_size_t overrun;
+    rt_bool_t dma;
+    rt_bool_t loopback;
+    sim_serial_peer_t peer;
+    void *peer_data;
+    int fd;
+};
+
+static rt_size_t sim_serial_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct sim_serial *sim = (struct sim_serial *) dev;
+    rt_uint8_t *out = buffer;
+    rt_size_t len = 0;
+    rt_base_t level;
+
+    RT_UNUSED(pos);
+    level = rt_hw_interrupt_disable();
+    while (len < size && sim->rx_count > 0)
+    {
+        out[len++] = sim->rx_buf[sim->rx_tail];
+        sim->rx_tail = (sim->rx_tail + 1) % sim->rx_bufsz;
+        sim->rx_count--;
+    }
+    rt_hw_interrupt_enable(level);
+    return len;
+}
+
+static rt_size_t sim_serial_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct sim_serial *sim = (struct sim_serial *) dev;
+
+    RT_UNUSED(pos);
+    if (sim->fd >= 0)
+    {
+        rt_size_t done = 0;
+        while (done < size)
+        {
+            ssize_t n = write(sim->fd, (const rt_uint8_t *) buffer + done, size - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        return done;
+    }
+    if (sim->loopback)
+        sim_serial_inject(&sim->serial, buffer, size);
+    if (sim->peer)
+        sim->peer(&sim->serial, buffer, size, sim->peer_data);
+    return size;
+}
+
+static rt_err_t sim_serial_control(rt_device_t dev, int cmd, void *args)
+{
+    struct sim_serial *sim = (struct sim_serial *) dev;
+
+    if (cmd == RT_DEVICE_CTRL_CONFIG && args)
+    {
+        sim->serial.config = *(struct serial_configure *) args;
+        return RT_EOK;
+    }
+    return -RT_ENOSYS;
+}
+
+static const struct rt_device_ops sim_serial_ops =
+{
+    RT_NULL, RT_NULL, RT_NULL, sim_serial_read, sim_serial_write, sim_serial_control
+};
+
+static struct sim_serial *sim_serial_alloc(const char *name, rt_size_t rx_bufsz, rt_bool_t dma)
+{
+    struct sim_serial *sim = calloc(1, sizeof(struct sim_serial));
+    struct serial_configure config = RT_SERIAL_CONFIG_DEFAULT;
+
+    sim->rx_buf = calloc(1, rx_bufsz);
+    sim->rx_bufsz = rx_bufsz;
+    sim->dma = dma;
+    sim->fd = -1;
+    sim->serial.config = config;
+    sim->serial.parent.type = RT_Device_Class_Char;
+    sim->serial.parent.ops = &sim_serial_ops;
+    rt_device_register(&sim->serial.parent, name,
+            RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_RX | (dma ? RT_DEVICE_FLAG_DMA_RX : 0));
+    return sim;
+}
+
+struct rt_serial_device *sim_serial_register(const char *name, rt_size_t rx_bufsz, rt_bool_t dma)
+{
+    return &sim_serial_alloc(name, rx_bufsz, dma)->serial;
+}
+
+void sim_serial_set_peer(struct rt_serial_device *serial, sim_serial_peer_t peer, void *user_data)
+{
+    struct sim_serial *sim = (struct sim_serial *) serial;
+
+    sim->peer = peer;
+    sim->peer_data = user_data;
+}
+
+void sim_serial_set_loopback(struct rt_serial_device *serial, rt_bool_t loopback)
+{
+    ((struct sim_serial *) serial)->loopback = loopback;
+}
+
+/* acts as the RX interrupt: buffers the bytes and calls rx_indicate with "interrupts" locked */
+rt_size_t sim_serial_inject(struct rt_serial_device *serial, const rt_uint8_t *data, rt_size_t size)
+{
+    struct sim_serial *sim = (struct sim_serial *) serial;
+    rt_size_t len = 0, count;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    while (len < size)
+    {
+        if (sim->rx_count == sim->rx_bufsz)
+        {
+            sim->overrun += size - len;
+            break;
+        }
+        sim->rx_buf[sim->rx_head] = data[len++];
+        sim->rx_head = (sim->rx_head + 1) % sim->rx_bufsz;
+        sim->rx_count++;
+    }
+    count = sim->rx_count;
+    if (len > 0 && serial->parent.rx_indicate)
+        serial->parent.rx_indicate(&serial->parent, sim->dma ? len : count);
+    rt_hw_interrupt_enable(level);
+    return len;
+}
+
+rt_size_t sim_serial_overrun(struct rt_serial_device *serial)
+{
+    return ((struct sim_serial *) serial)->overrun;
+}
+
+/* pseudo-terminal backed serial: a reader thread plays the RX interrupt */
+static void *pty_reader_entry(void *arg)
+{
+    struct sim_serial *sim = arg;
+    rt_uint8_t buf[256];
+    ssize_t n;
+
+    while ((n = read(sim->fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+    {
+        if (n > 0)
+            sim_serial_inject(&sim->serial, buf, n);
+    }
+    return RT_NULL;
+}
+
+struct rt_serial_device *pty_serial_register(const char *name, char *slave_path, rt_size_t path_size)
+{
+    struct sim_serial *sim;
+    struct termios tio;
+    int master, slave;
+    pthread_t tid;
+
+    if (openpty(&master, &slave, RT_NULL, RT_NULL, RT_NULL) != 0)
+        return RT_NULL;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    if (slave_path)
+        snprintf(slave_path, path_size, "%s", ttyname(slave));
+
+    sim = sim_serial_alloc(name, 4096, RT_FALSE);
+    sim->fd = master;
+    pthread_create(&tid, RT_NULL, pty_reader_entry, sim);
+    pthread_detach(tid);
+    return &sim->serial;
+}
+
+/* hwtimer: a thread sleeping until the deadline plays the timer interrupt */
+struct sim_hwtimer
+{
+    struct rt_device parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    rt_hwtimer_mode_t mode;
+    rt_uint64_t period_us;
+    rt_uint64_t deadline_us;
+    rt_bool_t armed;
+};
+
+static void *sim_hwtimer_entry(void *arg)
+{
+    struct sim_hwtimer *hw = arg;
+    struct timespec ts;
+    rt_base_t level;
+
+    pthread_mutex_lock(&hw->mtx);
+    while (1)
+    {
+        if (!hw->armed)
+        {
+            pthread_cond_wait(&hw->cond, &hw->mtx);
+            continue;
+        }
+        if (now_us() < hw->deadline_us)
+        {
+            ts.tv_sec = hw->deadline_us / 1000000ULL;
+            ts.tv_nsec = (hw->deadline_us % 1000000ULL) * 1000;
+            pthread_cond_timedwait(&hw->cond, &hw->mtx, &ts);
+            continue;
+        }
+        if (hw->mode == HWTIMER_MODE_PERIOD)
+            hw->deadline_us += hw->period_us;
+        else
+            hw->armed = RT_FALSE;
+        pthread_mutex_unlock(&hw->mtx);
+
+        level = rt_hw_interrupt_disable();
+        if (hw->parent.rx_indicate)
+            hw->parent.rx_indicate(&hw->parent, sizeof(rt_hwtimerval_t));
+        rt_hw_interrupt_enable(level);
+        pthread_mutex_lock(&hw->mtx);
+    }
+    return RT_NULL;
+}
+
+static rt_size_t sim_hwtimer_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct sim_hwtimer *hw = (struct sim_hwtimer *) dev;
+    const rt_hwtimerval_t *timeout = buffer;
+
+    if (size != sizeof(rt_hwtimerval_t))
+        return 0;
+    pthread_mutex_lock(&hw->mtx);
+    hw->period_us = (rt_uint64_t) timeout->sec * 1000000ULL + timeout->usec;
+    hw->deadline_us = now_us() + hw->period_us;
+    hw->armed = RT_TRUE;
+    pthread_cond_signal(&hw->cond);
+    pthread_mutex_unlock(&hw->mtx);
+    return size;
+}
+
+static rt_err_t sim_hwtimer_control(rt_device_t dev, int cmd, void *args)
+{
+    struct sim_hwtimer *hw = (struct sim_hwtimer *) dev;
+    rt_err_t result = RT_EOK;
+
+    pthread_mutex_lock(&hw->mtx);
+    switch (cmd)
+    {
+    case HWTIMER_CTRL_STOP:
+        hw->armed = RT_FALSE;
+        break;
+    case HWTIMER_CTRL_MODE_SET:
+        hw->mode = *(rt_hwtimer_mode_t *) args;
+        break;
+    case HWTIMER_CTRL_FREQ_SET:
+        break;
+    default:
+        result = -RT_ENOSYS;
+        break;
+    }
+    pthread_mutex_unlock(&hw->mtx);
+    return result;
+}
+
+static const struct rt_device_ops sim_hwtimer_ops =
+{
+    RT_NULL, RT_NULL, RT_NULL, RT_NULL, sim_hwtimer_write, sim_hwtimer_control
+};
+
+rt_device_t sim_hwtimer_register(const char *name)
+{
+    struct sim_hwtimer *hw = calloc(1, sizeof(struct sim_hwtimer));
+    pthread_t tid;
+
+    pthread_mutex_init(&hw->mtx, RT_NULL);
+    cond_init(&hw->cond);
+    hw->mode = HWTIMER_MODE_ONESHOT;
+    hw->parent.type = RT_Device_Class_Timer;
+    hw->parent.ops = &sim_hwtimer_ops;
+    rt_device_register(&hw->parent, name, RT_DEVICE_FLAG_RDWR);
+    pthread_create(&tid, RT_NULL, sim_hwtimer_entry, hw);
+    pthread_detach(tid);
+    return &hw->parent;
+}
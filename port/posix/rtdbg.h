@@ -0,0 +1,34 @@
+/*
+ * Debug log macros for the POSIX host shim.
+ */
+#ifndef __RTDBG_H__
+#define __RTDBG_H__
+
+#include <rtthread.h>
+
+#define DBG_ERROR           0
+#define DBG_WARNING         1
+#define DBG_INFO            2
+#define DBG_LOG             3
+
+#ifndef DBG_TAG
+#define DBG_TAG             "DBG"
+#endif
+#ifndef DBG_LVL
+#define DBG_LVL             DBG_WARNING
+#endif
+
+#define dbg_log_line(lvl, level, fmt, ...)                                  \
+    do {                                                                    \
+        if ((level) <= DBG_LVL)                                             \
+            rt_kprintf("[" lvl "/" DBG_TAG "] " fmt "\n", ##__VA_ARGS__);   \
+    } while (0)
+
+#define LOG_D(fmt, ...)     dbg_log_line("D", DBG_LOG, fmt, ##__VA_ARGS__)
+#define LOG_I(fmt, ...)     dbg_log_line("I", DBG_INFO, fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...)     dbg_log_line("W", DBG_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_E(fmt, ...)     dbg_log_line("E", DBG_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_RAW(...)        rt_kprintf(__VA_ARGS__)
+#define LOG_HEX(name, width, buf, size) ((void)(name), (void)(width), (void)(buf), (void)(size))
+
+#endif
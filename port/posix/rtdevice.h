@@ -0,0 +1,115 @@
+/*
+ * Serial, pin and hwtimer device definitions for the POSIX host shim.
+ */
+#ifndef __RTDEVICE_H__
+#define __RTDEVICE_H__
+
+#include <rtthread.h>
+
+#define BAUD_RATE_9600      9600
+#define BAUD_RATE_115200    115200
+#define BAUD_RATE_460800    460800
+#define BAUD_RATE_921600    921600
+
+#define DATA_BITS_8         8
+#define STOP_BITS_1         0
+#define STOP_BITS_2         1
+#define PARITY_NONE         0
+#define PARITY_ODD          1
+#define PARITY_EVEN         2
+
+#define RT_SERIAL_RB_BUFSZ  256
+
+struct serial_configure
+{
+    rt_uint32_t baud_rate;
+    rt_uint32_t data_bits    :4;
+    rt_uint32_t stop_bits    :2;
+    rt_uint32_t parity       :2;
+    rt_uint32_t bit_order    :1;
+    rt_uint32_t invert       :1;
+    rt_uint32_t bufsz        :16;
+    rt_uint32_t reserved     :6;
+};
+
+#define RT_SERIAL_CONFIG_DEFAULT           \
+{                                          \
+    BAUD_RATE_115200,                      \
+    DATA_BITS_8,                           \
+    STOP_BITS_1,                           \
+    PARITY_NONE,                           \
+    0,                                     \
+    0,                                     \
+    RT_SERIAL_RB_BUFSZ,                    \
+    0                                      \
+}
+
+struct rt_serial_device
+{
+    struct rt_device parent;
+    const void *ops;
+    struct serial_configure config;
+    void *serial_rx;
+    void *serial_tx;
+};
+
+/* hwtimer */
+typedef struct rt_hwtimerval
+{
+    rt_int32_t sec;
+    rt_int32_t usec;
+} rt_hwtimerval_t;
+
+typedef enum
+{
+    HWTIMER_CTRL_FREQ_SET = 0x01,
+    HWTIMER_CTRL_STOP,
+    HWTIMER_CTRL_INFO_GET,
+    HWTIMER_CTRL_MODE_SET
+} rt_hwtimer_ctrl_t;
+
+typedef enum
+{
+    HWTIMER_MODE_ONESHOT = 0x01,
+    HWTIMER_MODE_PERIOD
+} rt_hwtimer_mode_t;
+
+/* pin */
+#define PIN_LOW             0x00
+#define PIN_HIGH            0x01
+#define PIN_MODE_OUTPUT     0x00
+void rt_pin_mode(rt_base_t pin, rt_uint8_t mode);
+void rt_pin_write(rt_base_t pin, rt_uint8_t value);
+int rt_pin_read(rt_base_t pin);
+
+/*
+ * Host serial devices.
+ *
+ * sim_serial_register() creates an in-memory UART. Bytes written by the
+ * application are handed to the peer callback (a simulated slave), bytes fed
+ * with sim_serial_inject() appear on the receive side. In DMA mode the
+ * rx_indicate callback reports each received chunk, in interrupt mode it
+ * reports the total number of bytes buffered, like the serial v1 framework.
+ *
+ * pty_serial_register() backs the device with a pseudo-terminal instead; the
+ * slave side path is returned so an external program can act as the peer.
+ */
+typedef void (*sim_serial_peer_t)(struct rt_serial_device *serial, const rt_uint8_t *data, rt_size_t size,
+        void *user_data);
+
+struct rt_serial_device *sim_serial_register(const char *name, rt_size_t rx_bufsz, rt_bool_t dma);
+void sim_serial_set_peer(struct rt_serial_device *serial, sim_serial_peer_t peer, void *user_data);
+void sim_serial_set_loopback(struct rt_serial_device *serial, rt_bool_t loopback);
+rt_size_t sim_serial_inject(struct rt_serial_device *serial, const rt_uint8_t *data, rt_size_t size);
+rt_size_t sim_serial_overrun(struct rt_serial_device *serial);
+
+struct rt_serial_device *pty_serial_register(const char *name, char *slave_path, rt_size_t path_size);
+
+/*
+ * sim_hwtimer_register() creates a one-shot/periodic hwtimer device timed by
+ * the monotonic clock; rx_indicate is called from its own thread with
+ * "interrupts" locked when the timeout written to it expires.
+ */
+rt_device_t sim_hwtimer_register(const char *name);
+
+#endif
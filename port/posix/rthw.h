@@ -0,0 +1,11 @@
+/*
+ * CPU services for the POSIX host shim.
+ */
+#ifndef __RT_HW_H__
+#define __RT_HW_H__
+
+#include <rtthread.h>
+
+void rt_hw_us_delay(rt_uint32_t us);
+
+#endif
@@ -0,0 +1,394 @@
+/*
+ * Minimal RT-Thread API shim for building uart_client on a POSIX host.
+ *
+ * Only the kernel services used by this package are provided. IPC objects are
+ * mapped onto pthread mutexes/condition variables, ticks onto CLOCK_MONOTONIC
+ * and interrupt locking onto a single recursive process-wide mutex.
+ */
+#ifndef __RTTHREAD_H__
+#define __RTTHREAD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#ifndef PKG_USING_UART_CLIENT
+#define PKG_USING_UART_CLIENT
+#endif
+
+/* package options that rtconfig.h carries on the target */
+#ifndef PKG_UART_CLIENT_PRIORITY_START
+#define PKG_UART_CLIENT_PRIORITY_START  10
+#endif
+
+#ifndef PKG_UART_CLIENT_MAX_COUNT
+#define PKG_UART_CLIENT_MAX_COUNT       32
+#endif
+
+#define RT_NAME_MAX             8
+#define RT_USING_DEVICE_OPS
+#define RT_SERIAL_USING_DMA
+#define RT_USING_HWTIMER
+#define RT_USING_PIN
+#define RT_TICK_PER_SECOND      1000
+#define RT_THREAD_PRIORITY_MAX  32
+#define rt_inline               static __inline
+
+typedef int8_t      rt_int8_t;
+typedef int16_t     rt_int16_t;
+typedef int32_t     rt_int32_t;
+typedef int64_t     rt_int64_t;
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef uint64_t    rt_uint64_t;
+typedef int         rt_bool_t;
+typedef long        rt_base_t;
+typedef unsigned long rt_ubase_t;
+typedef rt_base_t   rt_err_t;
+typedef rt_uint32_t rt_tick_t;
+typedef rt_ubase_t  rt_size_t;
+typedef rt_base_t   rt_ssize_t;
+typedef rt_base_t   rt_off_t;
+
+#define RT_TRUE     1
+#define RT_FALSE    0
+#define RT_NULL     ((void *)0)
+
+#define RT_EOK      0
+#define RT_ERROR    1
+#define RT_ETIMEOUT 2
+#define RT_EFULL    3
+#define RT_EEMPTY   4
+#define RT_ENOMEM   5
+#define RT_ENOSYS   6
+#define RT_EBUSY    7
+#define RT_EIO      8
+#define RT_EINTR    9
+#define RT_EINVAL   10
+
+#define RT_WAITING_FOREVER  -1
+#define RT_WAITING_NO       0
+
+#define RT_ALIGN(size, align)   (((size) + (align) - 1) & ~((align) - 1))
+#define RT_ALIGN_SIZE           8
+#define ALIGN(n)                __attribute__((aligned(n)))
+
+#define RT_IPC_FLAG_FIFO        0x00
+#define RT_IPC_FLAG_PRIO        0x01
+#define RT_IPC_CMD_RESET        0x01
+
+#define RT_EVENT_FLAG_AND       0x01
+#define RT_EVENT_FLAG_OR        0x02
+#define RT_EVENT_FLAG_CLEAR     0x04
+
+#define RT_TIMER_FLAG_ONE_SHOT      0x0
+#define RT_TIMER_FLAG_PERIODIC      0x2
+#define RT_TIMER_FLAG_HARD_TIMER    0x0
+#define RT_TIMER_FLAG_SOFT_TIMER    0x4
+#define RT_TIMER_CTRL_SET_TIME      0x0
+#define RT_TIMER_CTRL_GET_TIME      0x1
+
+#define RT_THREAD_CTRL_CHANGE_PRIORITY  0x02
+
+#define RT_ASSERT(EX)                                                           \
+    do {                                                                        \
+        if (!(EX)) {                                                            \
+            rt_kprintf("(%s) assertion failed at %s:%d\n", #EX, __FILE__, __LINE__); \
+            rt_hw_assert_failed();                                              \
+        }                                                                       \
+    } while (0)
+
+#define rt_container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+
+#define RT_UNUSED(x)    ((void)(x))
+
+/* double list */
+struct rt_list_node
+{
+    struct rt_list_node *next;
+    struct rt_list_node *prev;
+};
+typedef struct rt_list_node rt_list_t;
+
+#define RT_LIST_OBJECT_INIT(object) { &(object), &(object) }
+#define rt_list_entry(node, type, member) rt_container_of(node, type, member)
+#define rt_list_for_each(pos, head) \
+    for (pos = (head)->next; pos != (head); pos = pos->next)
+#define rt_list_for_each_safe(pos, n, head) \
+    for (pos = (head)->next, n = pos->next; pos != (head); pos = n, n = pos->next)
+#define rt_list_first_entry(ptr, type, member) rt_list_entry((ptr)->next, type, member)
+
+static inline void rt_list_init(rt_list_t *l) { l->next = l->prev = l; }
+static inline void rt_list_insert_after(rt_list_t *l, rt_list_t *n)
+{
+    l->next->prev = n; n->next = l->next; l->next = n; n->prev = l;
+}
+static inline void rt_list_insert_before(rt_list_t *l, rt_list_t *n)
+{
+    l->prev->next = n; n->prev = l->prev; l->prev = n; n->next = l;
+}
+static inline void rt_list_remove(rt_list_t *n)
+{
+    n->next->prev = n->prev; n->prev->next = n->next; n->next = n->prev = n;
+}
+static inline int rt_list_isempty(const rt_list_t *l) { return l->next == l; }
+static inline unsigned int rt_list_len(const rt_list_t *l)
+{
+    unsigned int len = 0; const rt_list_t *p = l;
+    while (p->next != l) { p = p->next; len++; }
+    return len;
+}
+
+/* kernel object */
+struct rt_object
+{
+    char name[RT_NAME_MAX];
+    rt_uint8_t type;
+    rt_uint8_t flag;
+};
+typedef struct rt_object *rt_object_t;
+
+/* semaphore */
+struct rt_semaphore
+{
+    struct rt_object parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    rt_uint16_t value;
+};
+typedef struct rt_semaphore *rt_sem_t;
+
+/* mutex */
+struct rt_mutex
+{
+    struct rt_object parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    pthread_t owner;
+    rt_uint32_t hold;
+};
+typedef struct rt_mutex *rt_mutex_t;
+
+/* event */
+struct rt_event
+{
+    struct rt_object parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    rt_uint32_t set;
+};
+typedef struct rt_event *rt_event_t;
+
+/* mailbox */
+struct rt_mailbox
+{
+    struct rt_object parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    rt_ubase_t *msg_pool;
+    rt_uint16_t size;
+    rt_uint16_t entry;
+    rt_uint16_t in_offset;
+    rt_uint16_t out_offset;
+    rt_bool_t allocated;
+};
+typedef struct rt_mailbox *rt_mailbox_t;
+
+/* memory pool */
+struct rt_mempool
+{
+    struct rt_object parent;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    void *start_address;
+    rt_size_t size;
+    rt_size_t block_size;
+    rt_uint8_t *block_list;
+    rt_size_t block_total_count;
+    rt_size_t block_free_count;
+    rt_bool_t allocated;
+};
+typedef struct rt_mempool *rt_mp_t;
+
+/* timer */
+struct rt_timer
+{
+    struct rt_object parent;
+    rt_list_t row;
+    void (*timeout_func)(void *parameter);
+    void *parameter;
+    rt_tick_t init_tick;
+    rt_tick_t timeout_tick;
+    rt_bool_t active;
+    rt_bool_t allocated;
+};
+typedef struct rt_timer *rt_timer_t;
+
+/* thread */
+struct rt_thread
+{
+    char name[RT_NAME_MAX];
+    pthread_t tid;
+    void (*entry)(void *parameter);
+    void *parameter;
+    void *stack_addr;
+    rt_uint32_t stack_size;
+    rt_uint8_t current_priority;
+    rt_uint8_t init_priority;
+    rt_bool_t allocated;
+    rt_bool_t started;
+};
+typedef struct rt_thread *rt_thread_t;
+
+/* device */
+enum rt_device_class_type
+{
+    RT_Device_Class_Char = 0,
+    RT_Device_Class_Timer,
+    RT_Device_Class_Unknown
+};
+
+#define RT_DEVICE_FLAG_RDWR             0x003
+#define RT_DEVICE_OFLAG_RDWR            0x003
+#define RT_DEVICE_FLAG_INT_RX           0x100
+#define RT_DEVICE_FLAG_DMA_RX           0x200
+#define RT_DEVICE_FLAG_INT_TX           0x400
+#define RT_DEVICE_FLAG_DMA_TX           0x800
+#define RT_DEVICE_CTRL_CONFIG           0x03
+
+typedef struct rt_device *rt_device_t;
+struct rt_device_ops
+{
+    rt_err_t  (*init)   (rt_device_t dev);
+    rt_err_t  (*open)   (rt_device_t dev, rt_uint16_t oflag);
+    rt_err_t  (*close)  (rt_device_t dev);
+    rt_size_t (*read)   (rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+    rt_size_t (*write)  (rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+    rt_err_t  (*control)(rt_device_t dev, int cmd, void *args);
+};
+
+struct rt_device
+{
+    struct rt_object parent;
+    enum rt_device_class_type type;
+    rt_uint16_t flag;
+    rt_uint16_t open_flag;
+    rt_uint8_t ref_count;
+    rt_err_t (*rx_indicate)(rt_device_t dev, rt_size_t size);
+    rt_err_t (*tx_complete)(rt_device_t dev, void *buffer);
+    const struct rt_device_ops *ops;
+    void *user_data;
+};
+
+/* kernel services */
+void rt_hw_assert_failed(void);
+int rt_kprintf(const char *fmt, ...);
+#define rt_snprintf snprintf
+#define rt_sprintf  sprintf
+#define rt_memset   memset
+#define rt_memcpy   memcpy
+#define rt_memcmp   memcmp
+#define rt_memmove  memmove
+#define rt_strcmp   strcmp
+#define rt_strncmp  strncmp
+#define rt_strlen   strlen
+#define rt_strncpy  strncpy
+#define rt_strstr   strstr
+
+int __rt_ffs(int value);
+
+void *rt_malloc(rt_size_t size);
+void *rt_calloc(rt_size_t count, rt_size_t size);
+void rt_free(void *ptr);
+void rt_memory_info(rt_size_t *total, rt_size_t *used, rt_size_t *max_used);
+
+rt_tick_t rt_tick_get(void);
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms);
+
+rt_base_t rt_hw_interrupt_disable(void);
+void rt_hw_interrupt_enable(rt_base_t level);
+void rt_enter_critical(void);
+void rt_exit_critical(void);
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t rt_sem_detach(rt_sem_t sem);
+rt_sem_t rt_sem_create(const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t rt_sem_delete(rt_sem_t sem);
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t timeout);
+rt_err_t rt_sem_trytake(rt_sem_t sem);
+rt_err_t rt_sem_release(rt_sem_t sem);
+rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg);
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag);
+rt_err_t rt_mutex_detach(rt_mutex_t mutex);
+rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag);
+rt_err_t rt_mutex_delete(rt_mutex_t mutex);
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t timeout);
+rt_err_t rt_mutex_release(rt_mutex_t mutex);
+
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag);
+rt_err_t rt_event_detach(rt_event_t event);
+rt_event_t rt_event_create(const char *name, rt_uint8_t flag);
+rt_err_t rt_event_delete(rt_event_t event);
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set);
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t opt, rt_int32_t timeout, rt_uint32_t *recved);
+
+rt_err_t rt_mb_init(rt_mailbox_t mb, const char *name, void *msgpool, rt_size_t size, rt_uint8_t flag);
+rt_err_t rt_mb_detach(rt_mailbox_t mb);
+rt_mailbox_t rt_mb_create(const char *name, rt_size_t size, rt_uint8_t flag);
+rt_err_t rt_mb_delete(rt_mailbox_t mb);
+rt_err_t rt_mb_send(rt_mailbox_t mb, rt_ubase_t value);
+rt_err_t rt_mb_send_wait(rt_mailbox_t mb, rt_ubase_t value, rt_int32_t timeout);
+rt_err_t rt_mb_recv(rt_mailbox_t mb, rt_ubase_t *value, rt_int32_t timeout);
+
+rt_err_t rt_mp_init(rt_mp_t mp, const char *name, void *start, rt_size_t size, rt_size_t block_size);
+rt_err_t rt_mp_detach(rt_mp_t mp);
+rt_mp_t rt_mp_create(const char *name, rt_size_t block_count, rt_size_t block_size);
+rt_err_t rt_mp_delete(rt_mp_t mp);
+void *rt_mp_alloc(rt_mp_t mp, rt_int32_t time);
+void rt_mp_free(void *block);
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter,
+        rt_tick_t time, rt_uint8_t flag);
+rt_err_t rt_timer_detach(rt_timer_t timer);
+rt_timer_t rt_timer_create(const char *name, void (*timeout)(void *parameter), void *parameter,
+        rt_tick_t time, rt_uint8_t flag);
+rt_err_t rt_timer_delete(rt_timer_t timer);
+rt_err_t rt_timer_start(rt_timer_t timer);
+rt_err_t rt_timer_stop(rt_timer_t timer);
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg);
+
+rt_err_t rt_thread_init(struct rt_thread *thread, const char *name, void (*entry)(void *parameter), void *parameter,
+        void *stack_start, rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick);
+rt_err_t rt_thread_detach(rt_thread_t thread);
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+        rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick);
+rt_err_t rt_thread_delete(rt_thread_t thread);
+rt_err_t rt_thread_control(rt_thread_t thread, int cmd, void *arg);
+rt_err_t rt_thread_startup(rt_thread_t thread);
+rt_thread_t rt_thread_self(void);
+rt_err_t rt_thread_mdelay(rt_int32_t ms);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+
+rt_device_t rt_device_find(const char *name);
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags);
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag);
+rt_err_t rt_device_close(rt_device_t dev);
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg);
+rt_err_t rt_device_set_rx_indicate(rt_device_t dev, rt_err_t (*rx_ind)(rt_device_t dev, rt_size_t size));
+rt_err_t rt_device_set_tx_complete(rt_device_t dev, rt_err_t (*tx_done)(rt_device_t dev, void *buffer));
+
+/* shell and auto-initialization are not available on the host */
+#define MSH_CMD_EXPORT(command, desc)
+#define MSH_CMD_EXPORT_ALIAS(command, alias, desc)
+#define INIT_APP_EXPORT(fn)
+#define INIT_COMPONENT_EXPORT(fn)
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * End-to-end uart client benchmark for a Linux host.
+ *
+ * Build from the package root:
+ *   gcc -O2 -Iport/posix -Iinc port/posix/rt_posix.c src/uart_client.c src/uart_client_crc.c \
+ *       port/posix/uart_client_host_bench.c -o uart_client_host_bench -lpthread -lutil
+ *
+ * Usage: uart_client_host_bench [requests] [stream_frames]
+ *
+ * Every case runs against a simulated serial device whose slave echoes each
+ * request back from its own thread, the way a remote device answers after the
+ * request has left the wire. Request/response round trips are reported as p50
+ * and p99, followed by a streaming run in which unsolicited length-framed
+ * traffic is pushed through the receive engine as fast as the simulated driver
+ * accepts it. Cases cover receive buffer sizes, idle timeouts, the automatic
+ * character gap timed by ticks or by a hardware timer, length framing and DMA
+ * versus interrupt reception. The stress run feeds the DMA
+ * clients one byte per receive notification in bursts of thousands while the
+ * parser is held off, and every streamed frame is checked byte for byte. A
+ * final case runs over a pseudo-terminal so the kernel tty layer is part of
+ * the path. The heap taken by all clients is printed last; build once more
+ * with -DPKG_UART_CLIENT_USING_REACTOR to compare against the reactor mode
+ * (thread stacks are heap allocated on the host as well). The run opens with
+ * the throughput of every CRC kernel; add -DPKG_UART_CLIENT_CRC_SLICES=8 to
+ * include the sliced ones.
+ */
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <uart_client.h>
+#include <uart_client_crc.h>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FRAME_MAX     255
+#define BENCH_STRESS_BURST  4096
+
+struct bench_slave
+{
+    struct rt_serial_device *serial;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    rt_uint8_t buf[BENCH_FRAME_MAX * 4];
+    rt_size_t len;
+};
+
+struct bench_result
+{
+    rt_uint32_t p50_us;
+    rt_uint32_t p99_us;
+    rt_uint32_t errors;
+    double frames_per_s;
+    double bytes_per_s;
+};
+
+static struct rt_semaphore stream_done;
+static volatile rt_size_t stream_frames, stream_bytes, stream_expect, stream_corrupt;
+
+static rt_uint64_t bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (rt_uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+    rt_uint32_t x = *(const rt_uint32_t *) a, y = *(const rt_uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* peer callback, runs in the writer's context: hand the request to the slave thread */
+static void bench_slave_peer(struct rt_serial_device *serial, const rt_uint8_t *data, rt_size_t size, void *user_data)
+{
+    struct bench_slave *slave = user_data;
+
+    pthread_mutex_lock(&slave->mtx);
+    if (slave->len + size <= sizeof(slave->buf))
+    {
+        rt_memcpy(&slave->buf[slave->len], data, size);
+        slave->len += size;
+    }
+    pthread_cond_signal(&slave->cond);
+    pthread_mutex_unlock(&slave->mtx);
+}
+
+static void *bench_slave_entry(void *arg)
+{
+    struct bench_slave *slave = arg;
+    rt_uint8_t buf[sizeof(slave->buf)];
+    rt_size_t len, done;
+
+    while (1)
+    {
+        pthread_mutex_lock(&slave->mtx);
+        while (slave->len == 0)
+        {
+            pthread_cond_wait(&slave->cond, &slave->mtx);
+        }
+        len = slave->len;
+        rt_memcpy(buf, slave->buf, len);
+        slave->len = 0;
+        pthread_mutex_unlock(&slave->mtx);
+
+        for (done = 0; done < len; )
+        {
+            done += sim_serial_inject(slave->serial, &buf[done], len - done);
+        }
+    }
+    return RT_NULL;
+}
+
+static struct rt_serial_device *bench_serial(const char *name, rt_bool_t dma)
+{
+    struct bench_slave *slave = calloc(1, sizeof(struct bench_slave));
+    pthread_t tid;
+
+    slave->serial = sim_serial_register(name, 4096, dma);
+    pthread_mutex_init(&slave->mtx, RT_NULL);
+    pthread_cond_init(&slave->cond, RT_NULL);
+    sim_serial_set_peer(slave->serial, bench_slave_peer, slave);
+    pthread_create(&tid, RT_NULL, bench_slave_entry, slave);
+    pthread_detach(tid);
+    return slave->serial;
+}
+
+/* the pty slave end echoes everything it reads */
+static void *bench_pty_echo_entry(void *arg)
+{
+    int fd = (int) (rt_ubase_t) arg;
+    rt_uint8_t buf[BENCH_FRAME_MAX];
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        if (write(fd, buf, n) != n)
+            break;
+    }
+    return RT_NULL;
+}
+
+/* a length-framed request: byte 0 carries the frame size */
+static void bench_fill(rt_uint8_t *frame, rt_size_t size, rt_uint32_t seq)
+{
+    frame[0] = (rt_uint8_t) size;
+    for (rt_size_t i = 1; i < size; i++)
+    {
+        frame[i] = (rt_uint8_t) (seq + i);
+    }
+}
+
+static void bench_requests(uart_client_t client, rt_size_t frame_size, rt_uint32_t count, rt_uint32_t timeout_ms,
+        struct bench_result *result)
+{
+    rt_uint8_t req[BENCH_FRAME_MAX];
+    rt_uint32_t *rtt = calloc(count, sizeof(rt_uint32_t));
+    rt_uint64_t start, total;
+    rt_uint32_t ok = 0;
+
+    total = bench_now_us();
+    for (rt_uint32_t i = 0; i < count; i++)
+    {
+        bench_fill(req, frame_size, i);
+        start = bench_now_us();
+        if (uart_client_request_start(client, timeout_ms, req, frame_size) == RT_EOK
+                && client->resp.buf_size == frame_size && rt_memcmp(client->resp.buf, req, frame_size) == 0)
+        {
+            rtt[ok++] = (rt_uint32_t) (bench_now_us() - start);
+        }
+        uart_client_request_end(client, RT_TRUE);
+    }
+    total = bench_now_us() - total;
+
+    qsort(rtt, ok, sizeof(rt_uint32_t), bench_cmp_u32);
+    result->p50_us = ok ? rtt[ok / 2] : 0;
+    result->p99_us = ok ? rtt[(ok * 99) / 100 < ok ? (ok * 99) / 100 : ok - 1] : 0;
+    result->errors = count - ok;
+    result->frames_per_s = total ? ok * 1e6 / total : 0;
+    result->bytes_per_s = result->frames_per_s * frame_size * 2;
+    free(rtt);
+}
+
+static void bench_stream_handler(rt_uint8_t *frame_data, rt_size_t size)
+{
+    rt_size_t i = 1;
+
+    /* the frames of bench_fill() count up from their second byte */
+    while (i < size && frame_data[i] == (rt_uint8_t) (frame_data[1] + i - 1))
+    {
+        i++;
+    }
+    if (size < 2 || frame_data[0] != size || i < size)
+    {
+        stream_corrupt++;
+    }
+    stream_bytes += size;
+    if (++stream_frames == stream_expect)
+    {
+        rt_sem_release(&stream_done);
+    }
+}
+
+/*
+ * Push count back to back frames through the receive side and time their delivery.
+ * With stress set every byte raises its own notification and bursts of
+ * BENCH_STRESS_BURST bytes arrive while the parser cannot run.
+ */
+static void bench_stream(uart_client_t client, struct rt_serial_device *serial, rt_size_t frame_size,
+        rt_uint32_t count, rt_bool_t stress, struct bench_result *result)
+{
+    rt_uint8_t frame[BENCH_FRAME_MAX];
+    rt_uint64_t start;
+    rt_size_t done, burst = 0, len;
+
+    stream_frames = stream_bytes = stream_corrupt = 0;
+    stream_expect = count;
+    rt_sem_control(&stream_done, RT_IPC_CMD_RESET, RT_NULL);
+    uart_client_set_frame_handler(client, client->frame_timeout_ms, bench_stream_handler);
+
+    start = bench_now_us();
+    for (rt_uint32_t i = 0; i < count; i++)
+    {
+        bench_fill(frame, frame_size, i);
+        for (done = 0; done < frame_size; )
+        {
+            if (stress && burst == 0)
+            {
+                rt_enter_critical();
+            }
+            len = sim_serial_inject(serial, &frame[done], stress ? 1 : frame_size - done);
+            done += len;
+            if (stress && (++burst == BENCH_STRESS_BURST || len == 0))
+            {
+                rt_exit_critical();
+                burst = 0;
+            }
+            if (len == 0 || (!stress && done < frame_size))
+            {
+                /* driver buffer full, let the parser catch up like the line would */
+                sched_yield();
+            }
+        }
+    }
+    if (burst > 0)
+    {
+        rt_exit_critical();
+    }
+    rt_sem_take(&stream_done, 1000 + count / 10);
+    start = bench_now_us() - start;
+
+    uart_client_set_frame_handler(client, client->frame_timeout_ms, RT_NULL);
+    result->errors = count - stream_frames + stream_corrupt;
+    result->frames_per_s = start ? stream_frames * 1e6 / start : 0;
+    result->bytes_per_s = start ? stream_bytes * 1e6 / start : 0;
+}
+
+static void bench_print(const char *mode, rt_size_t buf_size, const char *framing, rt_uint32_t timeout_ms,
+        const struct bench_result *result, rt_bool_t latency)
+{
+    char timeout[16];
+
+    rt_snprintf(timeout, sizeof(timeout), timeout_ms ? "%u" : "-", timeout_ms);
+    if (latency)
+    {
+        rt_kprintf("%-5s %5u  %-7s %7s %8u %8u %10.0f %12.0f %6u\n", mode, (unsigned) buf_size, framing, timeout,
+                result->p50_us, result->p99_us, result->frames_per_s, result->bytes_per_s, result->errors);
+    }
+    else
+    {
+        rt_kprintf("%-5s %5u  %-7s %7s %8s %8s %10.0f %12.0f %6u\n", mode, (unsigned) buf_size, framing, timeout,
+                "-", "-", result->frames_per_s, result->bytes_per_s, result->errors);
+    }
+}
+
+/* MB/s of every CRC kernel over a 4 KiB buffer */
+static void bench_crc(void)
+{
+    static const char *const type_names[UART_CRC_TYPE_NUM] = { "crc16-modbus", "crc16-ccitt", "crc32", "sum8", "xor8" };
+    static const char *const kernel_names[UART_CRC_KERNEL_NUM] = { "bitwise", "table", "slice4", "slice8" };
+    static rt_uint8_t buf[4096];
+    volatile rt_uint32_t sink = 0;
+    uart_crc_update_t update;
+    rt_uint64_t start, rounds;
+
+    for (rt_size_t i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = (rt_uint8_t) (i * 131 + 7);
+    }
+    rt_kprintf("crc          kernel       MB/s\n");
+    for (int type = 0; type < UART_CRC_TYPE_NUM; type++)
+    {
+        for (int kernel = 0; kernel < UART_CRC_KERNEL_NUM; kernel++)
+        {
+            update = uart_crc_kernel((enum uart_crc_type) type, (enum uart_crc_kernel) kernel);
+            if (update == RT_NULL)
+                continue;
+            start = bench_now_us();
+            for (rounds = 0; bench_now_us() - start < 200000; rounds++)
+            {
+                sink ^= update((rt_uint32_t) rounds, buf, sizeof(buf));
+            }
+            rt_kprintf("%-12s %-8s %8d\n", type_names[type], kernel_names[kernel],
+                    (int) (rounds * sizeof(buf) / (bench_now_us() - start)));
+        }
+    }
+    rt_kprintf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const rt_size_t buf_sizes[] = { 64, 256, 1024 };
+    static const rt_uint32_t idle_timeouts[] = { 2, 10 };
+    struct uart_frame_config length_cfg = { UART_FRAME_LENGTH };
+    struct rt_serial_device *serial;
+    struct bench_result result;
+    uart_client_t client;
+    rt_uint32_t requests = 200, frames = 20000;
+    rt_size_t frame_size, heap_start, heap_used;
+    /* room for any counter value, the few devices made here keep their names within RT_NAME_MAX */
+    char name[16], timer_name[16], slave_path[64];
+    pthread_t tid;
+    int dev_num = 0, fd;
+
+    if (argc > 1)
+        requests = atoi(argv[1]);
+    if (argc > 2)
+        frames = atoi(argv[2]);
+
+    length_cfg.param.length.offset = 0;
+    length_cfg.param.length.size = 1;
+    rt_sem_init(&stream_done, "hbdone", 0, RT_IPC_FLAG_FIFO);
+    rt_memory_info(RT_NULL, &heap_start, RT_NULL);
+
+    bench_crc();
+    rt_kprintf("mode    buf  framing timeout  p50(us)  p99(us)   frames/s      bytes/s errors\n");
+    for (int dma = 0; dma < 2; dma++)
+    {
+        for (rt_size_t b = 0; b < sizeof(buf_sizes) / sizeof(buf_sizes[0]); b++)
+        {
+            frame_size = buf_sizes[b] / 2 < BENCH_FRAME_MAX ? buf_sizes[b] / 2 : BENCH_FRAME_MAX;
+
+            /* idle timeout framing: the round trip includes the silence that ends the response */
+            for (rt_size_t t = 0; t < sizeof(idle_timeouts) / sizeof(idle_timeouts[0]); t++)
+            {
+                rt_snprintf(name, sizeof(name), "hb%u", (unsigned) dev_num++);
+                serial = bench_serial(name, dma);
+                client = uart_client_create(name, buf_sizes[b], 0, idle_timeouts[t], RT_NULL);
+                if (client == RT_NULL)
+                    return 1;
+                bench_requests(client, frame_size, requests, 1000, &result);
+                bench_print(dma ? "dma" : "int", buf_sizes[b], "idle", idle_timeouts[t], &result, RT_TRUE);
+            }
+
+            /* character gap framing, 3.5 characters at 115200 baud timed by ticks or a hardware timer */
+            for (int hw = 0; hw < 2; hw++)
+            {
+                rt_snprintf(name, sizeof(name), "hb%u", (unsigned) dev_num++);
+                serial = bench_serial(name, dma);
+                client = uart_client_create(name, buf_sizes[b], 0, UART_CLIENT_FRAME_TIMEOUT_AUTO, RT_NULL);
+                if (client == RT_NULL)
+                    return 1;
+                if (hw)
+                {
+                    rt_snprintf(timer_name, sizeof(timer_name), "hbt%u", (unsigned) dev_num);
+                    sim_hwtimer_register(timer_name);
+                    if (uart_client_set_gap_timer(client, timer_name) != RT_EOK)
+                        return 1;
+                }
+                bench_requests(client, frame_size, requests, 1000, &result);
+                bench_print(dma ? "dma" : "int", buf_sizes[b], hw ? "gap-hw" : "gap", 0, &result, RT_TRUE);
+            }
+
+            /* length framing: frames end on their last byte, no timeout in the path */
+            rt_snprintf(name, sizeof(name), "hb%u", (unsigned) dev_num++);
+            serial = bench_serial(name, dma);
+            client = uart_client_create(name, buf_sizes[b], 0, 100, RT_NULL);
+            if (client == RT_NULL)
+                return 1;
+            uart_client_set_framing(client, &length_cfg);
+            bench_requests(client, frame_size, requests, 1000, &result);
+            bench_print(dma ? "dma" : "int", buf_sizes[b], "length", 0, &result, RT_TRUE);
+            bench_stream(client, serial, frame_size, frames, RT_FALSE, &result);
+            bench_print(dma ? "dma" : "int", buf_sizes[b], "stream", 0, &result, RT_FALSE);
+            if (dma)
+            {
+                bench_stream(client, serial, frame_size, frames, RT_TRUE, &result);
+                bench_print("dma", buf_sizes[b], "stress", 0, &result, RT_FALSE);
+            }
+        }
+    }
+
+    /* the same length-framed round trips through a pseudo-terminal */
+    serial = pty_serial_register("hbpty", slave_path, sizeof(slave_path));
+    if (serial == RT_NULL || (fd = open(slave_path, O_RDWR | O_NOCTTY)) < 0)
+        return 1;
+    pthread_create(&tid, RT_NULL, bench_pty_echo_entry, (void *) (rt_ubase_t) fd);
+    pthread_detach(tid);
+    client = uart_client_create("hbpty", 256, 0, 100, RT_NULL);
+    if (client == RT_NULL)
+        return 1;
+    uart_client_set_framing(client, &length_cfg);
+    bench_requests(client, 128, requests, 1000, &result);
+    bench_print("pty", 256, "length", 0, &result, RT_TRUE);
+
+    rt_memory_info(RT_NULL, &heap_used, RT_NULL);
+    dev_num++;
+    rt_kprintf("heap: %u bytes for %d clients, %u per client\n", (unsigned) (heap_used - heap_start), dev_num,
+            (unsigned) ((heap_used - heap_start) / dev_num));
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Replays a capture taken with uart_capture_start() on a Linux host.
+ *
+ * Build from the package root:
+ *   gcc -O2 -DPKG_UART_CLIENT_USING_CAPTURE -Iport/posix -Iinc port/posix/rt_posix.c src/uart_client.c \
+ *       src/uart_client_capture.c port/posix/uart_client_replay.c -o uart_client_replay -lpthread -lutil
+ *
+ * Usage: uart_client_replay <capture> [frame_timeout_ms] [channel] [realtime]
+ *
+ * The RX records of one channel, or of all of them by default, go through a
+ * client with idle framing, at full speed unless realtime is 1. The frames
+ * delivered and the wall time of the run are reported, so a production trace
+ * serves as a receive benchmark and its timing can be reproduced.
+ */
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <uart_client.h>
+#include <uart_client_capture.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define REPLAY_DEV_NAME     "ucrply"
+#define REPLAY_RING_SIZE    4096
+#define REPLAY_BUF_SIZE     256
+
+static volatile rt_size_t replay_frames;
+static volatile rt_size_t replay_bytes;
+
+static void replay_handler(rt_uint8_t *frame_data, rt_size_t size)
+{
+    replay_frames++;
+    replay_bytes += size;
+}
+
+static double replay_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    rt_uint32_t frame_timeout_ms = argc > 2 ? atoi(argv[2]) : 5;
+    int channel = argc > 3 ? atoi(argv[3]) : -1;
+    enum uart_replay_speed speed = (argc > 4 && atoi(argv[4])) ? UART_REPLAY_REALTIME : UART_REPLAY_MAX;
+    uart_client_t client;
+    rt_uint8_t *capture;
+    long size;
+    double start;
+    FILE *fp;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <capture> [frame_timeout_ms] [channel] [realtime]\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    capture = malloc(size);
+    if (capture == NULL || fread(capture, 1, size, fp) != (size_t) size)
+    {
+        printf("read %s failed\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+
+    if (uart_replay_device_register(REPLAY_DEV_NAME, REPLAY_RING_SIZE) != RT_EOK)
+        return 1;
+    client = uart_client_create(REPLAY_DEV_NAME, REPLAY_BUF_SIZE, 0, frame_timeout_ms, replay_handler);
+    if (client == RT_NULL)
+        return 1;
+
+    start = replay_now();
+    if (uart_replay(REPLAY_DEV_NAME, capture, size, channel, speed) != RT_EOK)
+        return 1;
+    /* the last frame ends on the idle timeout */
+    rt_thread_mdelay(frame_timeout_ms * 2 + 10);
+    printf("%lu frames, %lu bytes in %.3f s\n", (unsigned long) replay_frames, (unsigned long) replay_bytes,
+            replay_now() - start);
+
+    uart_client_delete(client);
+    free(capture);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * ulog front end for the POSIX host shim, forwarding to rtdbg.h.
+ */
+#ifndef __ULOG_H__
+#define __ULOG_H__
+
+#define LOG_LVL_ASSERT      0
+#define LOG_LVL_ERROR       0
+#define LOG_LVL_WARNING     1
+#define LOG_LVL_INFO        2
+#define LOG_LVL_DBG         3
+
+#ifdef LOG_TAG
+#define DBG_TAG             LOG_TAG
+#endif
+#ifdef LOG_LVL
+#define DBG_LVL             LOG_LVL
+#endif
+
+#include <rtdbg.h>
+
+#endif
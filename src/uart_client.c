@@ -1,31 +1,117 @@
 #include <rtthread.h>
+#include <rthw.h>
 #include <rtdevice.h>
 #include <uart_client.h>
+#ifdef PKG_UART_CLIENT_USING_CAPTURE
+#include <uart_client_capture.h>
+#endif
 
 #define DBG_TAG    "uart.client"
 #define DBG_LVL    DBG_INFO
 #include <rtdbg.h>
 
-#define CLIENT_LOCK_NAME            "uclock"
+#define CLIENT_LANE_NAME            "ucln"
 #define CLIENT_SEM_NAME             "ucsem"
-#define CLIENT_TXSEM_NAME           "uctxsem"
-#define CLIENT_MB_NAME              "ucmb"
+#define CLIENT_TXSEM_NAME           "ucts"
 #define CLIENT_SEM_RESP_NAME        "ucres"
-#define CLIENT_SEM_RESP_END_NAME    "ucrend"
+#define CLIENT_MP_NAME              "ucmp"
+#define CLIENT_SEM_TRANS_NAME       "uctr"
+#define CLIENT_TXMP_NAME            "uctp"
+#define CLIENT_TXMB_NAME            "ucmb"
+#define CLIENT_TXTHREAD_NAME        "uctx"
 #define CLIENT_THREAD_NAME          "uc"
-#define CLIENT_TIME_NAME            "uctime"
+#define CLIENT_TIME_NAME            "uctm"
+#define CLIENT_IDLE_NAME            "ucid"
+#define CLIENT_HANDLER_NAME         "uchd"
+#define CLIENT_REACTOR_NAME         "ucrt"
+#define CLIENT_WORKER_NAME          "ucw"
+#define CLIENT_DE_NAME              "ucde"
 
 #ifndef PKG_UART_CLIENT_MAX_COUNT
 #define PKG_UART_CLIENT_MAX_COUNT	8
 #endif
 
-#ifndef PKG_UART_CLIENT_THREAD_STACK_SIZE
-#define PKG_UART_CLIENT_THREAD_STACK_SIZE	512
+/* reactor mode: this many worker threads serve every client instead of one parser thread each */
+#ifndef PKG_UART_CLIENT_REACTOR_WORKERS
+#define PKG_UART_CLIENT_REACTOR_WORKERS	1
+#endif
+
+/*
+ * longest wait of the parser for a frame buffer, or of a request for the wire, before
+ * it looks for a request_start() never ended and retries
+ */
+#ifndef PKG_UART_CLIENT_RX_WATCHDOG_MS
+#define PKG_UART_CLIENT_RX_WATCHDOG_MS	500
+#endif
+
+/* time after request_start() returns until the wire and the response are taken back, 0: never */
+#ifndef PKG_UART_CLIENT_END_TIMEOUT_MS
+#define PKG_UART_CLIENT_END_TIMEOUT_MS	10000
+#endif
+
+/* stack buffer uart_client_request_batch() packs short requests into, one write each */
+#ifndef PKG_UART_CLIENT_BATCH_PACK_SIZE
+#define PKG_UART_CLIENT_BATCH_PACK_SIZE	64
+#endif
+
+/* device pointer hash for the rx indicate path, kept at most half full */
+#if PKG_UART_CLIENT_MAX_COUNT <= 8
+#define CLIENT_HASH_BITS            4
+#elif PKG_UART_CLIENT_MAX_COUNT <= 16
+#define CLIENT_HASH_BITS            5
+#elif PKG_UART_CLIENT_MAX_COUNT <= 32
+#define CLIENT_HASH_BITS            6
+#elif PKG_UART_CLIENT_MAX_COUNT <= 64
+#define CLIENT_HASH_BITS            7
+#elif PKG_UART_CLIENT_MAX_COUNT <= 128
+#define CLIENT_HASH_BITS            8
+#elif PKG_UART_CLIENT_MAX_COUNT <= 256
+#define CLIENT_HASH_BITS            9
+#else
+#error "PKG_UART_CLIENT_MAX_COUNT is limited to 256"
 #endif
+#define CLIENT_HASH_SIZE            (1 << CLIENT_HASH_BITS)
 
 #ifdef PKG_USING_UART_CLIENT
 
 static uart_client_t uart_client_list[PKG_UART_CLIENT_MAX_COUNT] = { 0 };
+static uart_client_t uart_client_hash[CLIENT_HASH_SIZE] = { 0 };
+
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+/* bit (index % 32) is raised for clients with pending receive work */
+static struct rt_event uart_client_reactor;
+static struct rt_thread uart_client_workers[PKG_UART_CLIENT_REACTOR_WORKERS];
+ALIGN(RT_ALIGN_SIZE) static rt_uint8_t uart_client_worker_stack[PKG_UART_CLIENT_REACTOR_WORKERS][PKG_UART_CLIENT_THREAD_STACK_SIZE];
+/* clients whose step stopped for lack of pool buffers, retried every tick */
+static volatile rt_uint32_t uart_client_reactor_starved;
+
+#define CLIENT_REACTOR_AGAIN        0x02
+
+#define CLIENT_REACTOR_BIT(client)  (1UL << ((client)->index & 31))
+#endif
+
+/* rx_flags: the receive step is running or held off by uart_client_rx_hold() */
+#define CLIENT_RX_BUSY              0x01
+/* rx_flags: a timer saw the frame gap expire */
+#define CLIENT_RX_IDLE              0x04
+
+/* queued request, followed by its data */
+struct uart_tx_msg
+{
+    rt_size_t size;
+};
+
+/* Count a tick interval in its log2 bucket, the last bucket also takes everything longer */
+static void uart_client_hist_add(rt_uint32_t *hist, rt_tick_t ticks)
+{
+    int i = 0;
+    while (ticks && i < UART_CLIENT_HIST_BUCKETS - 1)
+    {
+        ticks >>= 1;
+        i++;
+    }
+    hist[i]++;
+}
 
 /* Get uart client by client device name */
 uart_client_t uart_client_get_by_name(const char *dev_name)
@@ -40,476 +126,2747 @@ uart_client_t uart_client_get_by_name(const char *dev_name)
     return RT_NULL;
 }
 
-static rt_err_t uart_client_rx_ind(rt_device_t dev, rt_size_t size)
+/* Fibonacci hash of the device address, the first probe slot */
+rt_inline rt_uint32_t uart_client_hash_slot(rt_device_t dev)
 {
-    uart_client_t client = uart_client_get_by_name(dev->parent.name);
-    if (client)
+    return (rt_uint32_t) ((rt_uint32_t) (rt_ubase_t) dev * 2654435769UL) >> (32 - CLIENT_HASH_BITS);
+}
+
+/* Get uart client by its device in constant time, safe in interrupt context */
+uart_client_t uart_client_get_by_device(rt_device_t dev)
+{
+    rt_uint32_t slot = uart_client_hash_slot(dev);
+    uart_client_t client;
+
+    /* linear probing, the table never fills so an empty slot ends the search */
+    while ((client = uart_client_hash[slot]) != RT_NULL)
     {
-        if (client->rx_mb)
-        {
-            rt_mb_send(client->rx_mb, size);
-        }
-        else
-        {
-            rt_sem_release(client->rx_notice);
-        }
+        if (client->device == dev)
+            return client;
+        slot = (slot + 1) & (CLIENT_HASH_SIZE - 1);
     }
+    return RT_NULL;
+}
 
-    return RT_EOK;
+/* Publish a client in the list and the device hash */
+static void uart_client_register(uart_client_t client)
+{
+    rt_uint32_t slot = uart_client_hash_slot(client->device);
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    while (uart_client_hash[slot] != RT_NULL)
+    {
+        slot = (slot + 1) & (CLIENT_HASH_SIZE - 1);
+    }
+    uart_client_hash[slot] = client;
+    uart_client_list[client->index] = client;
+    rt_hw_interrupt_enable(level);
 }
 
-static rt_err_t uart_client_getbyte(uart_client_t client, rt_uint8_t *ch, rt_int32_t timeout)
+static void uart_client_unregister(uart_client_t client)
 {
-    rt_err_t result = RT_EOK;
-    while (rt_device_read(client->device, 0, ch, 1) == 0)
+    rt_uint32_t slot = uart_client_hash_slot(client->device), next, home;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    uart_client_list[client->index] = RT_NULL;
+    while (uart_client_hash[slot] != client)
+    {
+        slot = (slot + 1) & (CLIENT_HASH_SIZE - 1);
+    }
+    /* backward shift: pull later entries of the probe chain into the hole */
+    uart_client_hash[slot] = RT_NULL;
+    for (next = (slot + 1) & (CLIENT_HASH_SIZE - 1); uart_client_hash[next] != RT_NULL;
+            next = (next + 1) & (CLIENT_HASH_SIZE - 1))
     {
-        result = rt_sem_take(client->rx_notice, timeout);
-        if (result != RT_EOK)
+        home = uart_client_hash_slot(uart_client_hash[next]->device);
+        /* an entry may move back unless its home slot lies cyclically in (slot, next] */
+        if (((next - home) & (CLIENT_HASH_SIZE - 1)) >= ((next - slot) & (CLIENT_HASH_SIZE - 1)))
         {
-            return result;
+            uart_client_hash[slot] = uart_client_hash[next];
+            uart_client_hash[next] = RT_NULL;
+            slot = next;
         }
     }
+    rt_hw_interrupt_enable(level);
+}
 
-    return RT_EOK;
+/* Silence in us that ends a frame in Modbus RTU and automatic timeout mode, 0 otherwise */
+static rt_uint32_t uart_client_frame_gap_us(uart_client_t client)
+{
+    struct serial_configure *config = &((struct rt_serial_device *) client->device)->config;
+
+#if PKG_UART_CLIENT_FRAME_MODES & UART_FRAME_BUILD_MODBUS_RTU
+    if (client->frame_cfg.mode == UART_FRAME_MODBUS_RTU)
+    {
+        /* 11 bit characters, fixed 1750 us above 19200 baud as the Modbus serial line spec says */
+        if (config->baud_rate > 19200 || config->baud_rate == 0)
+            return 1750;
+        return 38500000UL / config->baud_rate;
+    }
+#endif
+    if (client->frame_timeout_ms != UART_CLIENT_FRAME_TIMEOUT_AUTO)
+        return 0;
+    if (config->baud_rate == 0)
+        return 1750;
+    /* 3.5 characters of start, data, parity and stop bits, stop_bits counts from 0 */
+    return ((1 + config->data_bits + (config->parity != PARITY_NONE) + config->stop_bits + 1) * 3500000UL
+            + config->baud_rate - 1) / config->baud_rate;
 }
 
-static rt_size_t uart_client_get_buf(uart_client_t client, rt_int32_t timeout)
+#ifdef UART_CLIENT_USING_DE_PIN
+/* Drive the RS485 transceiver for the write that follows */
+static void uart_client_de_begin(uart_client_t client)
 {
-    rt_size_t recv_index = 0;
-    rt_uint8_t temp_ch;
-    rt_size_t size = 0;
-    while (1)
+    if (client->de_pin >= 0)
     {
-        if (client->rx_mb)
-        {
-            if (rt_mb_recv(client->rx_mb, &size, RT_WAITING_FOREVER) == RT_EOK)
-            {
-                if (recv_index + size > client->recv_buf_size - 1)
-                    size = client->recv_buf_size - 1 - recv_index;
-                size = rt_device_read(client->device, 0, &client->recv_buf[recv_index], size);
-                recv_index += size;
-                while (rt_mb_recv(client->rx_mb, &size, timeout) == RT_EOK)
-                {
-                    if (recv_index + size > client->recv_buf_size - 1)
-                        size = client->recv_buf_size - 1 - recv_index;
-                    size = rt_device_read(client->device, 0, &client->recv_buf[recv_index], size);
-                    recv_index += size;
-                }
-                return recv_index;
-            }
-        }
-        else
+        rt_pin_write(client->de_pin, client->de_level);
+    }
+}
+
+/*
+ * The blocking write returns once the driver has taken the last character, which
+ * may still sit in the holding register behind the one shifting out. DE is held
+ * PKG_UART_CLIENT_DE_TURNAROUND_CHARS character times beyond that, timed by the
+ * de_timer interrupt while the writer sleeps, or by a short spin without one.
+ */
+static void uart_client_de_end(uart_client_t client)
+{
+    struct serial_configure *config = &((struct rt_serial_device *) client->device)->config;
+    rt_uint32_t turnaround_us = 0;
+#ifdef RT_USING_HWTIMER
+    rt_hwtimerval_t timeout;
+#endif
+
+    if (client->de_pin < 0)
+        return;
+    if (config->baud_rate > 0)
+    {
+        turnaround_us = ((1 + config->data_bits + (config->parity != PARITY_NONE) + config->stop_bits + 1)
+                * PKG_UART_CLIENT_DE_TURNAROUND_CHARS * 1000000UL + config->baud_rate - 1) / config->baud_rate;
+    }
+#ifdef RT_USING_HWTIMER
+    if (client->de_timer && turnaround_us > 0)
+    {
+        rt_sem_control(&client->de_done, RT_IPC_CMD_RESET, RT_NULL);
+        timeout.sec = turnaround_us / 1000000UL;
+        timeout.usec = turnaround_us % 1000000UL;
+        if (rt_device_write(client->de_timer, 0, &timeout, sizeof(timeout)) == sizeof(timeout))
         {
-            if (uart_client_getbyte(client, &temp_ch, timeout) == RT_EOK)
-            {
-                if (recv_index < client->recv_buf_size - 1)
-                {
-                    client->recv_buf[recv_index++] = temp_ch;
-                }
-                else
-                {
-                    return recv_index;
-                }
-            }
-            else
-            {
-                return recv_index;
-            }
+            /* the timer interrupt releases DE */
+            if (rt_sem_take(&client->de_done, rt_tick_from_millisecond(turnaround_us / 1000 + 1) + 1) == RT_EOK)
+                return;
+            /* it never fired, stop it so it cannot cut into the next write */
+            rt_device_control(client->de_timer, HWTIMER_CTRL_STOP, RT_NULL);
+            turnaround_us = 0;
         }
     }
+#endif
+    if (turnaround_us > 0)
+    {
+        rt_hw_us_delay(turnaround_us);
+    }
+    rt_pin_write(client->de_pin, !client->de_level);
 }
+#else
+#define uart_client_de_begin(client)
+#define uart_client_de_end(client)
+#endif
 
-rt_err_t uart_client_request_start(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf,
-        rt_size_t req_size)
+#ifdef PKG_UART_CLIENT_USING_CAPTURE
+/* Record one request as it went out, CRC trailer included */
+static void uart_client_capture_tx(uart_client_t client, const struct uart_iovec *iov, int iovcnt,
+        const rt_uint8_t *trailer, rt_size_t trailer_size)
 {
-    rt_err_t result = RT_EOK;
-    if (client == RT_NULL)
+    struct uart_capture_slot slot;
+    rt_size_t len = trailer_size;
+    int i;
+
+    if (!client->capture)
+        return;
+    for (i = 0; i < iovcnt; i++)
     {
-        LOG_E("the uart client is null!");
-        return -RT_EEMPTY;
+        len += iov[i].len;
+    }
+    if (!uart_capture_begin(client, UART_CAPTURE_TX, len, &slot))
+        return;
+    for (i = 0; i < iovcnt; i++)
+    {
+        uart_capture_append(&slot, iov[i].base, iov[i].len);
+    }
+    if (trailer_size > 0)
+    {
+        uart_capture_append(&slot, trailer, trailer_size);
     }
+    uart_capture_commit(&slot);
+}
 
-    rt_mutex_take(client->lock, RT_WAITING_FOREVER);
-    rt_sem_take(client->tx_sem, RT_WAITING_FOREVER);
+/* Record received bytes in the chunk one read returned, the unit a replay feeds back */
+static void uart_client_capture_rx(uart_client_t client, const rt_uint8_t *data, rt_size_t len)
+{
+    struct uart_capture_slot slot;
 
-    client->resp.timeout = rt_tick_from_millisecond(timeout_ms);
-    client->resp.buf = RT_NULL;
-    client->resp.buf_size = 0;
-    client->resp_consume = RT_FALSE;
-    if (client->resp.timeout == 0)
+    if (client->capture && uart_capture_begin(client, UART_CAPTURE_RX, len, &slot))
     {
-        rt_device_write(client->device, 0, req_buf, req_size);
-        if (client->send_interval_timer)
-        {
-            rt_timer_start(client->send_interval_timer);
-        }
-        else
-        {
-            rt_sem_release(client->tx_sem);
-        }
+        uart_capture_append(&slot, data, len);
+        uart_capture_commit(&slot);
     }
-    else
+}
+#else
+#define uart_client_capture_tx(client, iov, iovcnt, trailer, trailer_size)
+#define uart_client_capture_rx(client, data, len)
+#endif
+
+/* Idle time in ticks that ends a frame: frame_timeout_ms, or the character gap rounded up */
+static rt_int32_t uart_client_frame_timeout(uart_client_t client)
+{
+    rt_uint32_t gap_us = uart_client_frame_gap_us(client);
+
+    if (gap_us > 0)
+    {
+        /* one extra tick so a wait that starts just before a tick edge still lasts the full gap */
+        return (gap_us * RT_TICK_PER_SECOND + 999999UL) / 1000000UL + 1;
+    }
+
+    return rt_tick_from_millisecond(client->frame_timeout_ms);
+}
+
+#ifdef RT_USING_HWTIMER
+/* (Re)start the hardware gap timer on received data, from the rx indicate path */
+static void uart_client_gap_start(uart_client_t client)
+{
+    rt_hwtimerval_t timeout;
+    rt_uint32_t gap_us = uart_client_frame_gap_us(client);
+
+    if (gap_us == 0)
+        return;
+    timeout.sec = gap_us / 1000000UL;
+    timeout.usec = gap_us % 1000000UL;
+    rt_device_write(client->gap_timer, 0, &timeout, sizeof(timeout));
+}
+#endif
+
+/* Wake whoever runs the receive step of the client */
+rt_inline void uart_client_rx_notify(uart_client_t client)
+{
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+    rt_event_send(&uart_client_reactor, CLIENT_REACTOR_BIT(client));
+#else
+    rt_sem_release(&client->rx_notice);
+#endif
+}
+
+static rt_err_t uart_client_rx_ind(rt_device_t dev, rt_size_t size)
+{
+    uart_client_t client = uart_client_get_by_device(dev);
+    if (client)
     {
-        rt_sem_control(client->resp_notice, RT_IPC_CMD_RESET, RT_NULL);
-        rt_device_write(client->device, 0, req_buf, req_size);
-        if (client->send_interval_timer)
+        /*
+         * One wakeup per drain, not per byte or DMA chunk: the parser clears the flag
+         * before it reads, so nothing that arrives afterwards can go unnoticed.
+         */
+        if (!client->rx_pending)
         {
-            rt_timer_start(client->send_interval_timer);
+            client->rx_pending = RT_TRUE;
+            uart_client_rx_notify(client);
         }
         else
         {
-            rt_sem_release(client->tx_sem);
+            client->stats.rx_coalesced++;
         }
-        if (rt_sem_take(client->resp_notice, client->resp.timeout) != RT_EOK)
+#ifdef RT_USING_HWTIMER
+        if (client->gap_timer)
         {
-            LOG_D("uart client(%s) request timeout (%d ticks)!", client->device->parent.name, client->resp.timeout);
-            result = -RT_ETIMEOUT;
+            uart_client_gap_start(client);
         }
+#endif
     }
 
-    return result;
+    return RT_EOK;
 }
 
-rt_err_t uart_client_request_start_with_rs485(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf,
-        rt_size_t req_size, void (*set_tx)(void), void (*set_rx)(void))
+/*
+ * Run the framer over the unscanned bytes recv_buf[frame_state.size, recv_len).
+ * Frame bytes are kept from recv_buf[0] on, decoded in place. Returns the offset
+ * just past the last byte of a completed frame, or 0 while the frame is incomplete.
+ */
+static rt_size_t uart_client_frame_scan(uart_client_t client)
 {
-    rt_err_t result = RT_EOK;
-    if (client == RT_NULL)
-    {
-        LOG_E("the uart client is null!");
-        return -RT_EEMPTY;
-    }
-
-    rt_mutex_take(client->lock, RT_WAITING_FOREVER);
-    rt_sem_take(client->tx_sem, RT_WAITING_FOREVER);
+    const struct uart_frame_config *cfg = &client->frame_cfg;
+    struct uart_frame_state *state = &client->frame_state;
+    rt_size_t pos = state->size, out = state->size;
 
-    client->resp.timeout = rt_tick_from_millisecond(timeout_ms);
-    client->resp.buf = RT_NULL;
-    client->resp.buf_size = 0;
-    client->resp_consume = RT_FALSE;
-    if (client->resp.timeout == 0)
+    switch (cfg->mode)
     {
-        set_tx();
-        rt_device_write(client->device, 0, req_buf, req_size);
-        if (client->send_interval_timer)
-        {
-            rt_timer_start(client->send_interval_timer);
-        }
-        else
+#if PKG_UART_CLIENT_FRAME_MODES & UART_FRAME_BUILD_LENGTH
+    case UART_FRAME_LENGTH:
+    {
+        rt_uint8_t *buf = client->recv_buf;
+        rt_size_t header = cfg->param.length.offset + cfg->param.length.size, at;
+        rt_uint8_t ch;
+
+        while (pos < client->recv_len)
         {
-            rt_sem_release(client->tx_sem);
+            ch = buf[pos++];
+            /* position in the whole frame, the bytes already streamed out included */
+            at = client->stream_len + out;
+            if (at >= cfg->param.length.offset && at < header)
+            {
+                if (cfg->param.length.big_endian)
+                    state->value = (state->value << 8) | ch;
+                else
+                    state->value |= (rt_size_t) ch << (8 * (at - cfg->param.length.offset));
+            }
+            out++;
+            /* a length shorter than its own header ends the frame right after the header */
+            if (at + 1 >= header && (rt_int32_t) (at + 1) >= (rt_int32_t) state->value + cfg->param.length.adjust)
+            {
+                state->size = out;
+                return pos;
+            }
         }
-        set_rx();
+        break;
     }
-    else
+#endif
+
+#if PKG_UART_CLIENT_FRAME_MODES & UART_FRAME_BUILD_DELIMITER
+    case UART_FRAME_DELIMITER:
     {
-        rt_sem_control(client->resp_notice, RT_IPC_CMD_RESET, RT_NULL);
-        set_tx();
-        rt_device_write(client->device, 0, req_buf, req_size);
-        if (client->send_interval_timer)
+        rt_uint8_t *buf = client->recv_buf;
+        rt_uint8_t ch;
+
+        while (pos < client->recv_len)
         {
-            rt_timer_start(client->send_interval_timer);
+            ch = buf[pos++];
+            if (!(state->flags & UART_FRAME_STATE_IN_FRAME))
+            {
+                if (ch == cfg->param.delimiter.start)
+                    state->flags |= UART_FRAME_STATE_IN_FRAME;
+            }
+            else if (state->flags & UART_FRAME_STATE_ESCAPED)
+            {
+                state->flags &= ~UART_FRAME_STATE_ESCAPED;
+                if (ch == cfg->param.delimiter.escape_end)
+                    ch = cfg->param.delimiter.end;
+                else if (ch == cfg->param.delimiter.escape_start)
+                    ch = cfg->param.delimiter.start;
+                else if (ch == cfg->param.delimiter.escape_escape)
+                    ch = cfg->param.delimiter.escape;
+                buf[out++] = ch;
+            }
+            else if (ch == cfg->param.delimiter.escape)
+            {
+                state->flags |= UART_FRAME_STATE_ESCAPED;
+            }
+            else if (ch == cfg->param.delimiter.end)
+            {
+                /* back to back delimiters (start == end) open a new frame instead of an empty one */
+                if (out > 0 || client->stream_len > 0)
+                {
+                    state->size = out;
+                    return pos;
+                }
+            }
+            else if (ch == cfg->param.delimiter.start)
+            {
+                /* start inside a frame: the previous frame was cut off, resynchronize */
+                if (client->stream_len > 0)
+                    state->flags |= UART_FRAME_STATE_ABORTED;
+                out = 0;
+            }
+            else
+            {
+                buf[out++] = ch;
+            }
         }
-        else
+        break;
+    }
+#endif
+
+#if PKG_UART_CLIENT_FRAME_MODES & UART_FRAME_BUILD_TERMINATOR
+    case UART_FRAME_TERMINATOR:
+    {
+        rt_uint8_t *buf = client->recv_buf;
+        rt_uint8_t ch;
+
+        while (pos < client->recv_len)
         {
-            rt_sem_release(client->tx_sem);
+            ch = buf[pos++];
+            /* fall back to the longest terminator prefix still matching */
+            while (state->value > 0 && ch != (rt_uint8_t) cfg->param.terminator[state->value])
+                state->value = client->terminator_next[state->value - 1];
+            if (ch == (rt_uint8_t) cfg->param.terminator[state->value])
+                state->value++;
+            out++;
+            if (state->value == client->terminator_len)
+            {
+                state->size = out;
+                return pos;
+            }
         }
-        set_rx();
-        if (rt_sem_take(client->resp_notice, client->resp.timeout) != RT_EOK)
+        break;
+    }
+#endif
+
+#if PKG_UART_CLIENT_FRAME_MODES & UART_FRAME_BUILD_USER
+    case UART_FRAME_USER:
+    {
+        rt_size_t size;
+
+        out = pos = client->recv_len;
+        size = cfg->param.check(client->recv_buf, out);
+        if (size > 0 && size <= out)
         {
-            LOG_D("uart client(%s) request timeout (%d ticks)!", client->device->parent.name, client->resp.timeout);
-            result = -RT_ETIMEOUT;
+            state->size = size;
+            return size;
         }
+        break;
     }
+#endif
 
-    return result;
+    default:
+        out = pos = client->recv_len;
+        break;
+    }
+
+    state->size = out;
+    return 0;
 }
 
-void uart_client_request_end(uart_client_t client, rt_bool_t consume)
+/* Pass a chunk of an oversized frame to the stream handler, opening the frame on the first one */
+static void uart_client_stream_chunk(uart_client_t client, const rt_uint8_t *data, rt_size_t size)
 {
-    if (client == RT_NULL)
-        return;
+    const struct uart_stream_handler *handler = client->stream_handler;
 
-    client->resp.timeout = 0;
-    client->resp.buf = RT_NULL;
-    client->resp.buf_size = 0;
-    client->resp_consume = consume;
-    rt_sem_release(client->resp_end_notice);
-    rt_mutex_release(client->lock);
+    if (client->stream_len == 0 && handler && handler->begin)
+    {
+        handler->begin();
+    }
+    if (size > 0 && handler && handler->chunk)
+    {
+        handler->chunk(data, size);
+    }
+    client->stream_len += size;
 }
 
-rt_err_t uart_client_request_no_response(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size)
+static void uart_client_stream_end(uart_client_t client, enum uart_frame_end reason)
 {
-    rt_err_t res;
-    res = uart_client_request_start(client, 0, req_buf, req_size);
-    uart_client_request_end(client, RT_FALSE);
-    return res;
+    if (client->stream_handler && client->stream_handler->end)
+    {
+        client->stream_handler->end(reason, client->stream_len);
+    }
+    client->stream_len = 0;
 }
 
-rt_err_t uart_client_request_no_response_with_rs485(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size,
-        void (*set_tx)(void), void (*set_rx)(void))
+/* Frames reach the handler from the parser and from request_end(), one call at a time */
+static void uart_client_frame_handler(uart_client_t client, rt_uint8_t *frame, rt_size_t size)
 {
-    rt_err_t res;
-    res = uart_client_request_start_with_rs485(client, 0, req_buf, req_size, set_tx, set_rx);
-    uart_client_request_end(client, RT_FALSE);
-    return res;
+    rt_mutex_take(&client->handler_lock, RT_WAITING_FOREVER);
+    client->frame_handler(frame, size);
+    rt_mutex_release(&client->handler_lock);
 }
 
-static void client_parser(uart_client_t client)
+/* Arm or disarm the response slot; a frame still attached is returned to the pool */
+static void uart_client_resp_reset(uart_client_t client, rt_uint32_t timeout)
 {
-    rt_size_t size;
-    while (1)
-    {
-        if ((size = uart_client_get_buf(client, rt_tick_from_millisecond(client->frame_timeout_ms))) > 0)
-        {
-            rt_bool_t consume = RT_FALSE;
-            client->recv_buf[client->recv_buf_size - 1] = 0x00;
-            if (client->resp.timeout > 0)
-            {
-                client->resp.buf = client->recv_buf;
-                client->resp.buf_size = size;
+    rt_uint8_t *frame;
+    rt_base_t level;
 
-                rt_sem_control(client->resp_end_notice, RT_IPC_CMD_RESET, RT_NULL);
+    level = rt_hw_interrupt_disable();
+    frame = client->resp.buf;
+    client->resp.buf = RT_NULL;
+    client->resp.buf_size = 0;
+    client->resp.timeout = timeout;
+    rt_hw_interrupt_enable(level);
 
-                rt_sem_release(client->resp_notice);
-                rt_sem_take(client->resp_end_notice, RT_WAITING_FOREVER);
-                consume = client->resp_consume;
-            }
-            if (consume == RT_FALSE && client->frame_handler != RT_NULL)
-            {
-                client->frame_handler(client->recv_buf, size);
-            }
-            rt_memset(client->recv_buf, 0x00, client->recv_buf_size);
-        }
+    if (frame)
+    {
+        rt_mp_free(frame);
     }
 }
 
-static void send_interval_timeout(uart_client_t client)
+/*
+ * Lane of the calling thread by its own priority, one inherited or lent for the
+ * moment does not move it: more urgent than high_prio is high, less urgent than
+ * bulk_prio is bulk.
+ */
+static enum uart_lane uart_client_lane(uart_client_t client)
 {
-    rt_sem_release(client->tx_sem);
+    rt_uint8_t priority = rt_thread_self()->init_priority;
+
+    if (priority < client->lane_high_prio)
+        return UART_LANE_HIGH;
+    if (priority > client->lane_bulk_prio)
+        return UART_LANE_BULK;
+    return UART_LANE_NORMAL;
 }
 
-void uart_client_set_frame_handler(uart_client_t client, rt_uint32_t frame_timeout_ms,
-        void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
+/* Take the wire from owner for the oldest waiter of the most urgent lane, interrupts disabled */
+static void uart_client_lane_pass(uart_client_t client, rt_thread_t owner)
 {
-    if (client == RT_NULL)
-        return;
+    int lane;
 
-    client->frame_handler = frame_handler;
-    client->frame_timeout_ms = frame_timeout_ms;
+    /* take back only what was lent, a priority changed since then is not ours to undo */
+    if (client->lane_lent_prio != RT_THREAD_PRIORITY_MAX && owner->current_priority == client->lane_lent_prio)
+    {
+        rt_thread_control(owner, RT_THREAD_CTRL_CHANGE_PRIORITY, &client->lane_owner_prio);
+    }
+    client->lane_lent_prio = RT_THREAD_PRIORITY_MAX;
+    client->lane_owner = RT_NULL;
+    client->lane_hold = 0;
+    client->end_owed = RT_FALSE;
+    for (lane = UART_LANE_HIGH; lane < UART_LANE_NUM; lane++)
+    {
+        if (client->lane_waiting[lane] > 0)
+        {
+            client->lane_waiting[lane]--;
+            rt_sem_release(&client->lane_grant[lane]);
+            break;
+        }
+    }
+    if (lane == UART_LANE_NUM)
+    {
+        client->lane_busy = RT_FALSE;
+    }
 }
 
-uart_client_t uart_client_create(const char *dev_name, rt_size_t recv_buf_size, rt_uint32_t send_interval_ms,
-        rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
+/*
+ * A request_start() whose request_end() has not come PKG_UART_CLIENT_END_TIMEOUT_MS
+ * after it returned loses the response and the wire, so a caller that forgot it
+ * cannot stall everyone else. Its request_end() does nothing then.
+ */
+static void uart_client_end_watchdog(uart_client_t client)
 {
-    int result = RT_EOK;
-    static int client_num = 0;
-    char name[RT_NAME_MAX];
-    rt_err_t open_result = RT_EOK;
-    uart_client_t client = RT_NULL;
+    rt_thread_t owner;
+    rt_uint8_t *frame;
+    rt_base_t level;
 
-    RT_ASSERT(dev_name);RT_ASSERT(recv_buf_size > 0);
+    if (PKG_UART_CLIENT_END_TIMEOUT_MS == 0)
+        return;
 
-    if (client_num >= PKG_UART_CLIENT_MAX_COUNT)
+    level = rt_hw_interrupt_disable();
+    owner = client->lane_owner;
+    if (owner == RT_NULL || !client->end_owed
+            || rt_tick_get() - client->end_since < rt_tick_from_millisecond(PKG_UART_CLIENT_END_TIMEOUT_MS))
     {
-        result = -RT_EFULL;
-        goto __exit;
+        rt_hw_interrupt_enable(level);
+        return;
     }
+    frame = client->resp.buf;
+    client->resp.buf = RT_NULL;
+    client->resp.buf_size = 0;
+    client->resp.timeout = 0;
+    client->stats.end_reclaims++;
+    uart_client_lane_pass(client, owner);
+    rt_hw_interrupt_enable(level);
+
+    if (frame)
+    {
+        rt_mp_free(frame);
+    }
+    LOG_W("uart client(%s) took the wire back, no request_end() in %d ms.", client->device->parent.name,
+            PKG_UART_CLIENT_END_TIMEOUT_MS);
+}
+
+/*
+ * Own the wire, waiting behind the owner in the given lane if needed. The owner
+ * may nest requests. Fails with -RT_EINTR when a high lane request preempts the
+ * queued bulk requests.
+ */
+static rt_err_t uart_client_lane_take(uart_client_t client, enum uart_lane lane)
+{
+    rt_thread_t self = rt_thread_self();
+    rt_thread_t owner;
+    rt_uint16_t count;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (client->lane_owner == self)
+    {
+        client->lane_hold++;
+        client->end_owed = RT_FALSE;
+        rt_hw_interrupt_enable(level);
+        return RT_EOK;
+    }
+    if (client->lane_busy)
+    {
+        if (lane == UART_LANE_HIGH && client->lane_preempt)
+        {
+            for (count = client->lane_waiting[UART_LANE_BULK]; count > 0; count--)
+            {
+                client->lane_cancel++;
+                rt_sem_release(&client->lane_grant[UART_LANE_BULK]);
+            }
+            client->lane_waiting[UART_LANE_BULK] = 0;
+        }
+        /* lend our priority to the owner as the mutex this replaces did */
+        owner = client->lane_owner;
+        if (owner && self->current_priority < owner->current_priority)
+        {
+            if (client->lane_lent_prio == RT_THREAD_PRIORITY_MAX)
+            {
+                client->lane_owner_prio = owner->current_priority;
+            }
+            client->lane_lent_prio = self->current_priority;
+            rt_thread_control(owner, RT_THREAD_CTRL_CHANGE_PRIORITY, &client->lane_lent_prio);
+        }
+        client->lane_waiting[lane]++;
+        rt_hw_interrupt_enable(level);
+
+        /* the releasing owner keeps lane_busy set and hands the wire over */
+        while (rt_sem_take(&client->lane_grant[lane], rt_tick_from_millisecond(PKG_UART_CLIENT_RX_WATCHDOG_MS))
+                != RT_EOK)
+        {
+            uart_client_end_watchdog(client);
+        }
+
+        level = rt_hw_interrupt_disable();
+        if (lane == UART_LANE_BULK && client->lane_cancel > 0)
+        {
+            client->lane_cancel--;
+            rt_hw_interrupt_enable(level);
+            return -RT_EINTR;
+        }
+    }
+    client->lane_busy = RT_TRUE;
+    client->lane_owner = self;
+    client->lane_lent_prio = RT_THREAD_PRIORITY_MAX;
+    client->lane_hold = 0;
+    client->end_owed = RT_FALSE;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/* Hand the wire to the oldest waiter of the most urgent lane, a no-op for threads not owning it */
+static void uart_client_lane_release(uart_client_t client)
+{
+    rt_thread_t self = rt_thread_self();
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (client->lane_owner != self)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    if (client->lane_hold > 0)
+    {
+        client->lane_hold--;
+        /* back in the request_start() this was nested in, its request_end() is still owed */
+        client->end_owed = RT_TRUE;
+        client->end_since = rt_tick_get();
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    uart_client_lane_pass(client, self);
+    rt_hw_interrupt_enable(level);
+}
+
+/* Own the wire and wait out the send interval, the wait is recorded in the lane of the caller */
+static rt_err_t uart_client_tx_acquire(uart_client_t client)
+{
+    enum uart_lane lane = uart_client_lane(client);
+    struct uart_lane_stats *stats = &client->stats.lanes[lane];
+    rt_tick_t start, wait;
+
+    start = rt_tick_get();
+    if (uart_client_lane_take(client, lane) != RT_EOK)
+    {
+        stats->preempted++;
+        return -RT_EINTR;
+    }
+    rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+    wait = rt_tick_get() - start;
+
+    stats->requests++;
+    if (wait > stats->wait_max)
+    {
+        stats->wait_max = wait;
+    }
+    uart_client_hist_add(stats->wait_hist, wait);
+    uart_client_hist_add(client->stats.wait_hist, wait);
+
+    return RT_EOK;
+}
+
+/* Give up the wire after a write, to the next request once the send interval has passed */
+rt_inline void uart_client_tx_release(uart_client_t client)
+{
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+    if (client->send_interval)
+    {
+        rt_timer_start(&client->send_interval_timer);
+        return;
+    }
+#endif
+    rt_sem_release(&client->tx_sem);
+}
+
+static void uart_client_crc_trailer(const struct uart_tx_crc *tx_crc, rt_uint32_t crc, rt_uint8_t *trailer)
+{
+    int i;
+
+    crc ^= tx_crc->xor_out;
+    for (i = 0; i < tx_crc->size; i++)
+    {
+        trailer[tx_crc->big_endian ? tx_crc->size - 1 - i : i] = (rt_uint8_t) (crc >> (8 * i));
+    }
+}
+
+/* Write the segments back to back, followed by the CRC trailer if one is configured */
+static void uart_client_write_iov(uart_client_t client, const struct uart_iovec *iov, int iovcnt)
+{
+    const struct uart_tx_crc *tx_crc = client->tx_crc;
+    rt_uint8_t trailer[sizeof(rt_uint32_t)];
+    rt_size_t trailer_size = 0;
+    rt_uint32_t crc = 0;
+    int i;
+
+    if (tx_crc)
+    {
+        crc = tx_crc->init;
+    }
+    uart_client_de_begin(client);
+    for (i = 0; i < iovcnt; i++)
+    {
+        rt_device_write(client->device, 0, iov[i].base, iov[i].len);
+        client->stats.tx_bytes += iov[i].len;
+        /* runs while the driver is still shifting out the tail of this segment */
+        if (tx_crc)
+        {
+            crc = tx_crc->update(crc, iov[i].base, iov[i].len);
+        }
+    }
+    if (tx_crc && tx_crc->size > 0)
+    {
+        uart_client_crc_trailer(tx_crc, crc, trailer);
+        trailer_size = tx_crc->size;
+        rt_device_write(client->device, 0, trailer, trailer_size);
+        client->stats.tx_bytes += trailer_size;
+    }
+    uart_client_de_end(client);
+    client->stats.tx_frames++;
+    uart_client_capture_tx(client, iov, iovcnt, trailer, trailer_size);
+}
+
+/* Fold one response time into the estimate, the first one seeds it */
+void uart_rtt_update(struct uart_rtt *rtt, rt_tick_t sample)
+{
+    rt_int32_t m = (rt_int32_t) sample;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (rtt->samples == 0)
+    {
+        rtt->srtt = m << 3;
+        rtt->rttvar = m << 1;
+    }
+    else
+    {
+        m -= rtt->srtt >> 3;
+        rtt->srtt += m;
+        if (m < 0)
+            m = -m;
+        m -= rtt->rttvar >> 2;
+        rtt->rttvar += m;
+    }
+    rtt->samples++;
+    rtt->backoff = 0;
+    rt_hw_interrupt_enable(level);
+}
+
+/* A request timed out, later ones wait twice as long until a response is timed again */
+void uart_rtt_backoff(struct uart_rtt *rtt)
+{
+    if (rtt->backoff < 16)
+    {
+        rtt->backoff++;
+    }
+}
+
+/*
+ * srtt + 4 * rttvar, doubled per backoff; 0 without an estimate. On a steady link
+ * rttvar decays to nothing, so the margin is kept at a quarter of srtt or a tick,
+ * plus a tick for the part of one the measurement and the wait may each lose.
+ */
+rt_tick_t uart_rtt_rto(const struct uart_rtt *rtt)
+{
+    rt_int32_t margin;
+    rt_tick_t rto;
+
+    if (rtt->samples == 0)
+        return 0;
+    margin = rtt->srtt >> 5;
+    if (margin < rtt->rttvar)
+    {
+        margin = rtt->rttvar;
+    }
+    rto = (rtt->srtt >> 3) + (margin > 1 ? margin : 1) + 1;
+    if (rto > ((rt_tick_t) -1 >> 1 >> rtt->backoff))
+        return (rt_tick_t) -1 >> 1;
+    return rto << rtt->backoff;
+}
+
+/* The estimate async requests with this key are timed against */
+static struct uart_rtt *uart_client_rtt(uart_client_t client, rt_uint32_t key)
+{
+    return client->rtt_keys ? &client->rtt_keys[key % client->rtt_key_count] : &client->rtt;
+}
+
+/* Ticks to wait for a response: timeout_ms, or in auto mode the estimate capped by it */
+static rt_tick_t uart_client_timeout(uart_client_t client, const struct uart_rtt *rtt, rt_uint32_t timeout_ms)
+{
+    rt_tick_t timeout = rt_tick_from_millisecond(timeout_ms), rto;
+
+    if (timeout_ms == 0 || !client->auto_timeout)
+        return timeout;
+    rto = uart_rtt_rto(rtt);
+    if (rto == 0)
+        return timeout;
+    if (rto < client->auto_timeout_min)
+    {
+        rto = client->auto_timeout_min;
+    }
+    return rto < timeout ? rto : timeout;
+}
+
+/* Whether the retry policy tries a failed attempt again, after sleeping its backoff */
+static rt_bool_t uart_client_retry(uart_client_t client, rt_uint32_t *attempt, rt_err_t result)
+{
+    const struct uart_retry *retry = &client->retry;
+    rt_uint32_t backoff_ms;
+
+    if (*attempt >= retry->attempts)
+        return RT_FALSE;
+    /* a preempted request never reached the wire, a timed out one may have been executed */
+    if (result != -RT_EINTR && !(result == -RT_ETIMEOUT && (retry->flags & UART_RETRY_IDEMPOTENT)))
+        return RT_FALSE;
+
+    backoff_ms = *attempt - 1 < 16 ? retry->backoff_ms << (*attempt - 1) : retry->backoff_max_ms;
+    if (retry->backoff_max_ms > 0 && backoff_ms > retry->backoff_max_ms)
+    {
+        backoff_ms = retry->backoff_max_ms;
+    }
+    (*attempt)++;
+    client->stats.retries++;
+    if (backoff_ms > 0)
+    {
+        rt_thread_mdelay(backoff_ms);
+    }
+    return RT_TRUE;
+}
+
+static rt_err_t uart_client_transmit(uart_client_t client, rt_uint32_t timeout_ms, const struct uart_iovec *iov,
+        int iovcnt, void (*set_tx)(void), void (*set_rx)(void))
+{
+    rt_uint32_t attempt = 1;
+    rt_err_t result;
+    rt_tick_t start;
+    if (client == RT_NULL)
+    {
+        LOG_E("the uart client is null!");
+        return -RT_EEMPTY;
+    }
+
+    while ((result = uart_client_tx_acquire(client)) != RT_EOK)
+    {
+        if (!uart_client_retry(client, &attempt, result))
+            return result;
+    }
+
+    while (1)
+    {
+        uart_client_resp_reset(client, uart_client_timeout(client, &client->rtt, timeout_ms));
+        if (client->resp.timeout > 0)
+        {
+            rt_sem_control(&client->resp_notice, RT_IPC_CMD_RESET, RT_NULL);
+        }
+#ifndef PKG_UART_CLIENT_WITHOUT_RS485
+        if (set_tx)
+        {
+            set_tx();
+        }
+#endif
+        uart_client_write_iov(client, iov, iovcnt);
+        start = rt_tick_get();
+        uart_client_tx_release(client);
+#ifndef PKG_UART_CLIENT_WITHOUT_RS485
+        if (set_rx)
+        {
+            set_rx();
+        }
+#endif
+        if (client->resp.timeout == 0)
+            break;
+
+        client->stats.requests++;
+        if (rt_sem_take(&client->resp_notice, client->resp.timeout) == RT_EOK)
+        {
+            start = rt_tick_get() - start;
+            uart_client_hist_add(client->stats.rtt_hist, start);
+            /* a response to a repeated request may answer an earlier attempt, it is not timed */
+            if (attempt == 1)
+            {
+                uart_rtt_update(&client->rtt, start);
+            }
+            break;
+        }
+        LOG_D("uart client(%s) request timeout (%d ticks)!", client->device->parent.name, client->resp.timeout);
+        client->stats.timeouts++;
+        uart_rtt_backoff(&client->rtt);
+        result = -RT_ETIMEOUT;
+        if (!uart_client_retry(client, &attempt, result))
+            break;
+        /* the wire stays with this request, the next attempt follows the send interval */
+        rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+        result = RT_EOK;
+    }
+    /* and with the caller until request_end(), see uart_client_end_watchdog() */
+    client->end_since = rt_tick_get();
+    client->end_owed = RT_TRUE;
+
+    return result;
+}
+
+rt_err_t uart_client_request_start(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf,
+        rt_size_t req_size)
+{
+    struct uart_iovec iov = { req_buf, req_size };
+    return uart_client_transmit(client, timeout_ms, &iov, 1, RT_NULL, RT_NULL);
+}
+
+/* Scatter-gather variant: the segments are written in order without being copied together */
+rt_err_t uart_client_request_startv(uart_client_t client, rt_uint32_t timeout_ms, const struct uart_iovec *iov,
+        int iovcnt)
+{
+    return uart_client_transmit(client, timeout_ms, iov, iovcnt, RT_NULL, RT_NULL);
+}
+
+/*
+ * Return the response frame to the pool; if not consumed, the frame handler sees it first in this thread,
+ * after any call the parser is making to it. Does nothing after a request_start that was preempted and so
+ * never owned the wire.
+ */
+void uart_client_request_end(uart_client_t client, rt_bool_t consume)
+{
+    rt_uint8_t *frame;
+    rt_size_t size;
+    rt_base_t level;
+
+    if (client == RT_NULL || client->lane_owner != rt_thread_self())
+        return;
+
+    level = rt_hw_interrupt_disable();
+    frame = client->resp.buf;
+    size = client->resp.buf_size;
+    client->resp.timeout = 0;
+    client->resp.buf = RT_NULL;
+    client->resp.buf_size = 0;
+    rt_hw_interrupt_enable(level);
+
+    if (frame)
+    {
+        if (consume == RT_FALSE && client->frame_handler != RT_NULL)
+        {
+            client->stats.handled++;
+            uart_client_frame_handler(client, frame, size);
+        }
+        else if (consume)
+        {
+            client->stats.consumed++;
+        }
+        rt_mp_free(frame);
+    }
+    uart_client_lane_release(client);
+}
+
+rt_err_t uart_client_request_no_response(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size)
+{
+    rt_err_t res;
+    res = uart_client_request_start(client, 0, req_buf, req_size);
+    uart_client_request_end(client, RT_FALSE);
+    return res;
+}
+
+rt_err_t uart_client_request_no_responsev(uart_client_t client, const struct uart_iovec *iov, int iovcnt)
+{
+    rt_err_t res;
+    res = uart_client_request_startv(client, 0, iov, iovcnt);
+    uart_client_request_end(client, RT_FALSE);
+    return res;
+}
+
+#ifndef PKG_UART_CLIENT_WITHOUT_RS485
+/* set_tx/set_rx variants, the same transaction with the hooks around the write */
+rt_err_t uart_client_request_start_with_rs485(uart_client_t client, rt_uint32_t timeout_ms, rt_uint8_t *req_buf,
+        rt_size_t req_size, void (*set_tx)(void), void (*set_rx)(void))
+{
+    struct uart_iovec iov = { req_buf, req_size };
+    return uart_client_transmit(client, timeout_ms, &iov, 1, set_tx, set_rx);
+}
+
+rt_err_t uart_client_request_startv_with_rs485(uart_client_t client, rt_uint32_t timeout_ms,
+        const struct uart_iovec *iov, int iovcnt, void (*set_tx)(void), void (*set_rx)(void))
+{
+    return uart_client_transmit(client, timeout_ms, iov, iovcnt, set_tx, set_rx);
+}
+
+rt_err_t uart_client_request_no_response_with_rs485(uart_client_t client, rt_uint8_t *req_buf, rt_size_t req_size,
+        void (*set_tx)(void), void (*set_rx)(void))
+{
+    rt_err_t res;
+    res = uart_client_request_start_with_rs485(client, 0, req_buf, req_size, set_tx, set_rx);
+    uart_client_request_end(client, RT_FALSE);
+    return res;
+}
+
+rt_err_t uart_client_request_no_responsev_with_rs485(uart_client_t client, const struct uart_iovec *iov, int iovcnt,
+        void (*set_tx)(void), void (*set_rx)(void))
+{
+    rt_err_t res;
+    res = uart_client_request_startv_with_rs485(client, 0, iov, iovcnt, set_tx, set_rx);
+    uart_client_request_end(client, RT_FALSE);
+    return res;
+}
+#endif
+
+/*
+ * Items from first on that fit one write: without a send interval, requests that
+ * expect no response are packed together with the next item into buf. Returns the
+ * number of items taken and their size in *len, or 1 and 0 to send the item alone.
+ */
+static rt_size_t uart_client_batch_pack(uart_client_t client, const struct uart_batch_item *items, rt_size_t count,
+        rt_uint8_t *buf, rt_size_t *len)
+{
+    const struct uart_tx_crc *tx_crc = client->tx_crc;
+    rt_size_t crc_size = tx_crc ? tx_crc->size : 0;
+    rt_size_t n, pos = 0;
+    rt_uint32_t crc;
+
+    *len = 0;
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+    if (client->send_interval)
+        return 1;
+#endif
+
+    for (n = 0; n < count; n++)
+    {
+        if (pos + items[n].req_size + crc_size > PKG_UART_CLIENT_BATCH_PACK_SIZE)
+            break;
+        rt_memcpy(buf + pos, items[n].req_buf, items[n].req_size);
+        if (tx_crc)
+        {
+            crc = tx_crc->update(tx_crc->init, items[n].req_buf, items[n].req_size);
+            uart_client_crc_trailer(tx_crc, crc, buf + pos + items[n].req_size);
+        }
+        pos += items[n].req_size + crc_size;
+        if (items[n].timeout_ms > 0)
+        {
+            n++;
+            break;
+        }
+    }
+    if (n < 2)
+        return 1;
+
+    *len = pos;
+    return n;
+}
+
+/* uart_client_batch_run() flags */
+#define CLIENT_BATCH_UNTIMED        0x01    /* repeated items, a response may answer an earlier attempt */
+#define CLIENT_BATCH_OWN_RTT        0x02    /* timeouts as given, the client's estimate is left alone */
+
+/* The batch, with response times fed to the estimate unless flags say otherwise */
+static rt_err_t uart_client_batch_run(uart_client_t client, struct uart_batch_item *items, rt_size_t count,
+        rt_uint8_t flags)
+{
+    rt_uint8_t buf[PKG_UART_CLIENT_BATCH_PACK_SIZE];
+    struct uart_batch_item *item;
+    struct uart_iovec iov;
+    rt_err_t result;
+    rt_size_t i, n, len;
+    rt_tick_t start;
+
+    if (client == RT_NULL)
+    {
+        LOG_E("the uart client is null!");
+        return -RT_EEMPTY;
+    }
+    if (count == 0)
+    {
+        return RT_EOK;
+    }
+    RT_ASSERT(items);
+
+    result = uart_client_tx_acquire(client);
+    if (result != RT_EOK)
+    {
+        /* nothing was sent, no item keeps what an earlier batch left in it */
+        for (i = 0; i < count; i++)
+        {
+            items[i].resp_size = 0;
+            items[i].result = result;
+            items[i].rtt = 0;
+        }
+        return result;
+    }
+
+    for (i = 0; i < count; i += n)
+    {
+        if (i > 0)
+        {
+            /* the send interval of the previous item */
+            rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+        }
+        n = uart_client_batch_pack(client, &items[i], count - i, buf, &len);
+        item = &items[i + n - 1];
+
+        uart_client_resp_reset(client, (flags & CLIENT_BATCH_OWN_RTT) ? rt_tick_from_millisecond(item->timeout_ms)
+                : uart_client_timeout(client, &client->rtt, item->timeout_ms));
+        if (client->resp.timeout > 0)
+        {
+            rt_sem_control(&client->resp_notice, RT_IPC_CMD_RESET, RT_NULL);
+        }
+        if (len > 0)
+        {
+            uart_client_de_begin(client);
+            rt_device_write(client->device, 0, buf, len);
+            uart_client_de_end(client);
+            client->stats.tx_bytes += len;
+            client->stats.tx_frames += n;
+            iov.base = buf;
+            iov.len = len;
+            uart_client_capture_tx(client, &iov, 1, RT_NULL, 0);
+        }
+        else
+        {
+            iov.base = (rt_uint8_t *) item->req_buf;
+            iov.len = item->req_size;
+            uart_client_write_iov(client, &iov, 1);
+        }
+        start = rt_tick_get();
+        uart_client_tx_release(client);
+
+        for (item = &items[i]; item < &items[i + n]; item++)
+        {
+            item->resp_size = 0;
+            item->result = RT_EOK;
+            item->rtt = 0;
+        }
+        item = &items[i + n - 1];
+        if (client->resp.timeout > 0)
+        {
+            client->stats.requests++;
+            if (rt_sem_take(&client->resp_notice, client->resp.timeout) != RT_EOK)
+            {
+                client->stats.timeouts++;
+                if (!(flags & CLIENT_BATCH_OWN_RTT))
+                {
+                    uart_rtt_backoff(&client->rtt);
+                }
+                item->result = -RT_ETIMEOUT;
+            }
+            else
+            {
+                item->rtt = rt_tick_get() - start;
+                uart_client_hist_add(client->stats.rtt_hist, item->rtt);
+                if (!(flags & (CLIENT_BATCH_UNTIMED | CLIENT_BATCH_OWN_RTT)))
+                {
+                    uart_rtt_update(&client->rtt, item->rtt);
+                }
+                item->resp_size = client->resp.buf_size < item->resp_buf_size ?
+                        client->resp.buf_size : item->resp_buf_size;
+                rt_memcpy(item->resp_buf, client->resp.buf, item->resp_size);
+                client->stats.consumed++;
+            }
+            if (item->result != RT_EOK && result == RT_EOK)
+            {
+                result = item->result;
+            }
+        }
+    }
+    uart_client_resp_reset(client, 0);
+    uart_client_lane_release(client);
+
+    return result;
+}
+
+/*
+ * Run the items back to back while owning the wire once. The send interval is
+ * kept between items; without one, short requests that expect no response share
+ * a write with the item after them. Every item gets its own result and the
+ * response, cut to resp_buf_size, is copied into resp_buf. Returns the result of
+ * the first item that failed. Items are not retried.
+ */
+rt_err_t uart_client_request_batch(uart_client_t client, struct uart_batch_item *items, rt_size_t count)
+{
+    return uart_client_batch_run(client, items, count, 0);
+}
+
+/*
+ * uart_client_request_batch() for callers keeping their own response time
+ * estimates: every item waits its timeout_ms as given, and the client's estimate
+ * is neither applied nor updated.
+ */
+rt_err_t uart_client_request_batch_untimed(uart_client_t client, struct uart_batch_item *items, rt_size_t count)
+{
+    return uart_client_batch_run(client, items, count, CLIENT_BATCH_OWN_RTT);
+}
+
+/*
+ * Send a request and copy its response, cut to resp_buf_size, into resp_buf. The
+ * response frame goes back to the pool before this returns, so the caller never
+ * holds the wire or a receive buffer, not even between retries.
+ */
+rt_err_t uart_client_transact(uart_client_t client, rt_uint32_t timeout_ms, const rt_uint8_t *req_buf,
+        rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size, rt_size_t *resp_size)
+{
+    struct uart_batch_item item = { req_buf, req_size, timeout_ms, resp_buf, resp_buf_size, 0, RT_EOK, 0 };
+    rt_uint32_t attempt = 1;
+    rt_err_t result;
+
+    RT_ASSERT(timeout_ms > 0);
+    while ((result = uart_client_batch_run(client, &item, 1, attempt == 1 ? 0 : CLIENT_BATCH_UNTIMED)) != RT_EOK)
+    {
+        if (client == RT_NULL || !uart_client_retry(client, &attempt, result))
+            break;
+    }
+    if (resp_size)
+    {
+        *resp_size = item.resp_size;
+    }
+    return result;
+}
+
+/* Append a CRC computed segment by segment to everything the client sends, RT_NULL to disable */
+void uart_client_set_tx_crc(uart_client_t client, const struct uart_tx_crc *tx_crc)
+{
+    if (client == RT_NULL)
+        return;
+
+    RT_ASSERT(tx_crc == RT_NULL || (tx_crc->update && tx_crc->size <= sizeof(rt_uint32_t)));
+    client->tx_crc = tx_crc;
+}
+
+/*
+ * Check every received frame against a trailing CRC, RT_NULL to disable. Good frames
+ * are delivered without it; bad ones are counted and dropped, or with drop_bad
+ * RT_FALSE delivered as received. Streamed frames are not checked.
+ */
+void uart_client_set_rx_crc(uart_client_t client, const struct uart_tx_crc *rx_crc, rt_bool_t drop_bad)
+{
+    if (client == RT_NULL)
+        return;
+
+    RT_ASSERT(rx_crc == RT_NULL || (rx_crc->update && rx_crc->size <= sizeof(rt_uint32_t)));
+    client->rx_crc_drop = drop_bad;
+    client->rx_crc = rx_crc;
+}
+
+#ifdef UART_CLIENT_USING_DE_PIN
+/*
+ * Half-duplex RS485: de_pin is driven to de_level while the client writes and back
+ * PKG_UART_CLIENT_DE_TURNAROUND_CHARS character times after the blocking write
+ * returns, see uart_client_de_end(). A negative pin disables it.
+ */
+void uart_client_set_rs485(uart_client_t client, rt_base_t de_pin, rt_uint8_t de_level)
+{
+    if (client == RT_NULL)
+        return;
+
+    /* no write in progress while the pin changes */
+    uart_client_lane_take(client, UART_LANE_HIGH);
+    rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+    if (de_pin >= 0)
+    {
+        rt_pin_mode(de_pin, PIN_MODE_OUTPUT);
+        rt_pin_write(de_pin, !de_level);
+    }
+    client->de_pin = de_pin;
+    client->de_level = de_level;
+    rt_sem_release(&client->tx_sem);
+    uart_client_lane_release(client);
+}
+
+#ifdef RT_USING_HWTIMER
+/* End of the turnaround, from the timer interrupt */
+static rt_err_t uart_client_de_timeout(rt_device_t dev, rt_size_t size)
+{
+    uart_client_t client = dev->user_data;
+
+    rt_pin_write(client->de_pin, !client->de_level);
+    rt_sem_release(&client->de_done);
+
+    return RT_EOK;
+}
+
+/* Swap the turnaround timer, the caller keeps writes out */
+static void uart_client_de_timer_swap(uart_client_t client, rt_device_t timer)
+{
+    rt_device_t old = client->de_timer;
+
+    client->de_timer = timer;
+    if (old)
+    {
+        rt_device_control(old, HWTIMER_CTRL_STOP, RT_NULL);
+        rt_device_set_rx_indicate(old, RT_NULL);
+        rt_device_close(old);
+    }
+}
+
+/*
+ * Time the RS485 turnaround with a hardware timer of its own, not the gap timer:
+ * the writer sleeps and the timer interrupt releases DE, instead of a spin that
+ * holds the CPU. RT_NULL goes back to the spin.
+ */
+rt_err_t uart_client_set_de_timer(uart_client_t client, const char *timer_name)
+{
+    rt_hwtimer_mode_t mode = HWTIMER_MODE_ONESHOT;
+    rt_device_t timer = RT_NULL;
+
+    if (client == RT_NULL)
+        return -RT_EEMPTY;
+
+    if (timer_name)
+    {
+        timer = rt_device_find(timer_name);
+        if (timer == RT_NULL || timer->type != RT_Device_Class_Timer)
+        {
+            LOG_E("uart client(%s) not find the hwtimer(%s).", client->device->parent.name, timer_name);
+            return -RT_ERROR;
+        }
+        if (rt_device_open(timer, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+        {
+            LOG_E("uart client(%s) open hwtimer(%s) failed.", client->device->parent.name, timer_name);
+            return -RT_EIO;
+        }
+        timer->user_data = client;
+        rt_device_set_rx_indicate(timer, uart_client_de_timeout);
+        rt_device_control(timer, HWTIMER_CTRL_MODE_SET, &mode);
+    }
+
+    /* no write in progress while the timer changes */
+    uart_client_lane_take(client, UART_LANE_HIGH);
+    rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+    uart_client_de_timer_swap(client, timer);
+    rt_sem_release(&client->tx_sem);
+    uart_client_lane_release(client);
+
+    return RT_EOK;
+}
+#endif
+#endif
+
+/*
+ * Map requesting threads to lanes by priority: threads more urgent than high_prio
+ * use the high lane, those less urgent than bulk_prio the bulk lane and the rest
+ * the normal lane. With preempt, a high lane request fails the queued bulk
+ * requests with -RT_EINTR; the one on the wire always completes.
+ */
+void uart_client_set_lanes(uart_client_t client, rt_uint8_t high_prio, rt_uint8_t bulk_prio, rt_bool_t preempt)
+{
+    if (client == RT_NULL)
+        return;
+
+    RT_ASSERT(high_prio <= bulk_prio);
+    client->lane_high_prio = high_prio;
+    client->lane_bulk_prio = bulk_prio;
+    client->lane_preempt = preempt;
+}
+
+/*
+ * Auto timeout: the timeout_ms of a request becomes an upper bound and the client
+ * waits for the estimated round trip time instead, at least min_ms, once one
+ * response was timed. Timeouts double the wait until a response is timed again.
+ */
+void uart_client_set_auto_timeout(uart_client_t client, rt_bool_t enable, rt_uint32_t min_ms)
+{
+    if (client == RT_NULL)
+        return;
+
+    client->auto_timeout_min = rt_tick_from_millisecond(min_ms);
+    client->auto_timeout = enable;
+}
+
+/* Time async requests per matcher key, key % count picks the estimate; RT_NULL shares the client's */
+void uart_client_set_rtt_keys(uart_client_t client, struct uart_rtt *table, rt_size_t count)
+{
+    if (client == RT_NULL)
+        return;
+
+    RT_ASSERT(table == RT_NULL || count > 0);
+    if (table)
+    {
+        rt_memset(table, 0x00, count * sizeof(struct uart_rtt));
+    }
+    client->rtt_key_count = count;
+    client->rtt_keys = table;
+}
+
+/*
+ * Try requests made with request_start or transact up to retry->attempts times.
+ * Preempted requests never reached the wire and are always tried again, timed
+ * out ones only with UART_RETRY_IDEMPOTENT. request_start keeps the wire during
+ * the backoff; transact releases it. RT_NULL disables retries.
+ */
+void uart_client_set_retry(uart_client_t client, const struct uart_retry *retry)
+{
+    if (client == RT_NULL)
+        return;
+
+    if (retry)
+    {
+        client->retry = *retry;
+    }
+    else
+    {
+        rt_memset(&client->retry, 0x00, sizeof(client->retry));
+    }
+}
+
+void uart_client_set_matcher(uart_client_t client,
+        rt_err_t (*matcher)(rt_uint8_t *frame_data, rt_size_t size, rt_uint32_t *key))
+{
+    if (client == RT_NULL)
+        return;
+
+    client->matcher = matcher;
+}
+
+/* Send a request without waiting; the response matched by key is copied into resp_buf */
+rt_err_t uart_client_request_async(uart_client_t client, uart_transaction_t trans, rt_uint32_t key,
+        rt_uint32_t timeout_ms, rt_uint8_t *req_buf, rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size)
+{
+    struct uart_iovec iov = { req_buf, req_size };
+    rt_base_t level;
+
+    if (client == RT_NULL)
+    {
+        LOG_E("the uart client is null!");
+        return -RT_EEMPTY;
+    }
+    if (client->matcher == RT_NULL)
+    {
+        LOG_E("uart client(%s) has no response matcher!", client->device->parent.name);
+        return -RT_ENOSYS;
+    }
+
+    rt_sem_init(&trans->done, CLIENT_SEM_TRANS_NAME, 0, RT_IPC_FLAG_FIFO);
+    trans->key = key;
+    trans->start = rt_tick_get();
+    /* the time to wait for it, counted once it is on the wire */
+    trans->deadline = uart_client_timeout(client, uart_client_rtt(client, key), timeout_ms);
+    trans->buf = resp_buf;
+    trans->buf_size = resp_buf_size;
+    trans->resp_size = 0;
+    trans->result = -RT_ETIMEOUT;
+
+    /* queue before writing so a fast response always finds its waiter */
+    level = rt_hw_interrupt_disable();
+    rt_list_insert_before(&client->trans_list, &trans->list);
+    rt_hw_interrupt_enable(level);
+
+    if (uart_client_tx_acquire(client) != RT_EOK)
+    {
+        /* never written, nothing can match it */
+        level = rt_hw_interrupt_disable();
+        rt_list_remove(&trans->list);
+        rt_hw_interrupt_enable(level);
+        rt_sem_detach(&trans->done);
+        return -RT_EINTR;
+    }
+    uart_client_write_iov(client, &iov, 1);
+    /* a response matched before this store is timed from the queueing instead */
+    trans->start = rt_tick_get();
+    trans->deadline += trans->start;
+    client->stats.requests++;
+    uart_client_tx_release(client);
+    uart_client_lane_release(client);
+
+    return RT_EOK;
+}
+
+/* Wait until the transaction is matched or its own timeout expires, must follow every request_async */
+rt_err_t uart_client_request_wait(uart_client_t client, uart_transaction_t trans)
+{
+    rt_int32_t remain;
+    rt_bool_t queued;
+    rt_base_t level;
+
+    if (client == RT_NULL)
+        return -RT_EEMPTY;
+
+    remain = (rt_int32_t) (trans->deadline - rt_tick_get());
+    if (rt_sem_take(&trans->done, remain > 0 ? remain : 0) != RT_EOK)
+    {
+        level = rt_hw_interrupt_disable();
+        queued = !rt_list_isempty(&trans->list);
+        if (queued)
+        {
+            rt_list_remove(&trans->list);
+        }
+        rt_hw_interrupt_enable(level);
+
+        if (queued)
+        {
+            LOG_D("uart client(%s) transaction 0x%08x timeout!", client->device->parent.name, trans->key);
+            client->stats.timeouts++;
+            uart_rtt_backoff(uart_client_rtt(client, trans->key));
+        }
+        else
+        {
+            /* matched while timing out, the parser is still copying the response */
+            rt_sem_take(&trans->done, RT_WAITING_FOREVER);
+        }
+    }
+    rt_sem_detach(&trans->done);
+
+    return trans->result;
+}
+
+/* Copy the frame to the oldest outstanding transaction with the same key */
+static rt_bool_t uart_client_trans_deliver(uart_client_t client, rt_uint8_t *frame, rt_size_t size)
+{
+    uart_transaction_t trans = RT_NULL;
+    rt_list_t *node;
+    rt_uint32_t key;
+    rt_base_t level;
+    rt_tick_t rtt;
+
+    if (client->matcher == RT_NULL || rt_list_isempty(&client->trans_list))
+        return RT_FALSE;
+    if (client->matcher(frame, size, &key) != RT_EOK)
+        return RT_FALSE;
+
+    level = rt_hw_interrupt_disable();
+    rt_list_for_each(node, &client->trans_list)
+    {
+        if (rt_list_entry(node, struct uart_transaction, list)->key == key)
+        {
+            trans = rt_list_entry(node, struct uart_transaction, list);
+            rt_list_remove(&trans->list);
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (trans == RT_NULL)
+        return RT_FALSE;
+
+    trans->resp_size = size < trans->buf_size ? size : trans->buf_size;
+    rt_memcpy(trans->buf, frame, trans->resp_size);
+    trans->result = (trans->resp_size < size) ? -RT_EFULL : RT_EOK;
+    client->stats.consumed++;
+    rtt = rt_tick_get() - trans->start;
+    uart_client_hist_add(client->stats.rtt_hist, rtt);
+    uart_rtt_update(uart_client_rtt(client, key), rtt);
+    rt_sem_release(&trans->done);
+    rt_mp_free(frame);
+    return RT_TRUE;
+}
+
+/* Hand the frame to a waiting requester, returns RT_FALSE if nobody is waiting */
+static rt_bool_t uart_client_resp_deliver(uart_client_t client, rt_uint8_t *frame, rt_size_t size)
+{
+    rt_bool_t delivered = RT_FALSE;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (client->resp.timeout > 0 && client->resp.buf == RT_NULL)
+    {
+        client->resp.buf = frame;
+        client->resp.buf_size = size;
+        delivered = RT_TRUE;
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (delivered)
+    {
+        rt_sem_release(&client->resp_notice);
+    }
+
+    return delivered;
+}
+
+/* Verify the CRC trailer of a frame and strip it */
+static rt_bool_t uart_client_rx_crc_check(const struct uart_tx_crc *rx_crc, rt_uint8_t *frame, rt_size_t *size)
+{
+    rt_size_t len;
+    rt_uint32_t crc;
+    int i;
+
+    if (*size < rx_crc->size)
+        return RT_FALSE;
+
+    len = *size - rx_crc->size;
+    crc = rx_crc->update(rx_crc->init, frame, len) ^ rx_crc->xor_out;
+    for (i = 0; i < rx_crc->size; i++)
+    {
+        if (frame[len + (rx_crc->big_endian ? rx_crc->size - 1 - i : i)] != (rt_uint8_t) (crc >> (8 * i)))
+            return RT_FALSE;
+    }
+    frame[len] = 0x00;
+    *size = len;
+    return RT_TRUE;
+}
+
+/*
+ * Take the frame out of recv_buf and deliver it: to the transaction or requester
+ * waiting for it, else to the stream or frame handler. Bytes after end belong to
+ * the next frame and move into a fresh pool buffer.
+ */
+static void uart_client_rx_dispatch(uart_client_t client, rt_size_t size, rt_size_t end, enum uart_frame_end reason,
+        rt_int32_t alloc_timeout)
+{
+    rt_uint8_t *frame;
+
+    frame = client->recv_buf;
+    client->recv_buf = RT_NULL;
+    if (end < client->recv_len)
+    {
+        /* the read ran past this frame, carry the rest into the next buffer */
+        client->recv_buf = rt_mp_alloc(&client->frame_pool, alloc_timeout);
+        RT_ASSERT(client->recv_buf != RT_NULL);
+        rt_memcpy(client->recv_buf, &frame[end], client->recv_len - end);
+    }
+    client->recv_len -= end;
+    client->stats.rx_frames++;
+    frame[size] = 0x00;
+
+    if (client->rx_crc && client->stream_len == 0 && !uart_client_rx_crc_check(client->rx_crc, frame, &size))
+    {
+        client->stats.rx_crc_errors++;
+        if (client->rx_crc_drop)
+        {
+            rt_mp_free(frame);
+            return;
+        }
+    }
+
+    if (client->stream_len > 0)
+    {
+        /* the tail of a frame that did not fit into recv_buf */
+        client->stats.handled++;
+        uart_client_stream_chunk(client, frame, size);
+        uart_client_stream_end(client, reason);
+    }
+    else if (uart_client_trans_deliver(client, frame, size) || uart_client_resp_deliver(client, frame, size))
+    {
+        return;
+    }
+    else if (client->stream_handler != RT_NULL)
+    {
+        client->stats.handled++;
+        uart_client_stream_chunk(client, frame, size);
+        uart_client_stream_end(client, reason);
+    }
+    else if (client->frame_handler != RT_NULL)
+    {
+        client->stats.handled++;
+        uart_client_frame_handler(client, frame, size);
+    }
+    rt_mp_free(frame);
+}
+
+/* Wait for the application to return a frame buffer, the parser is the only one allocating */
+static rt_bool_t uart_client_pool_wait(uart_client_t client, rt_int32_t timeout)
+{
+    void *block;
+
+    if (timeout == 0)
+        return RT_FALSE;
+    block = rt_mp_alloc(&client->frame_pool, timeout);
+    if (block == RT_NULL)
+        return RT_FALSE;
+    rt_mp_free(block);
+    return RT_TRUE;
+}
+
+/*
+ * Receive engine step, never waits for the line: scan what is buffered, drain the
+ * driver and deliver every completed frame. idle means the line has been quiet
+ * for the frame timeout, so an open frame ends once the driver is empty. Pool
+ * buffers are waited for up to alloc_timeout; with 0 the step stops early and
+ * returns CLIENT_RX_STARVED while the application holds them all. Nothing is
+ * dropped meanwhile: further input waits in the driver.
+ */
+#define CLIENT_RX_READ              0x01
+#define CLIENT_RX_STARVED           0x02
+
+static rt_uint8_t uart_client_rx_step(uart_client_t client, rt_bool_t idle, rt_int32_t alloc_timeout)
+{
+    rt_uint8_t status = 0;
+    rt_size_t end, len;
+
+    while (1)
+    {
+        if (client->recv_buf == RT_NULL)
+        {
+            /* every frame is held by the application, reception resumes on the first release */
+            client->recv_buf = rt_mp_alloc(&client->frame_pool, alloc_timeout);
+            if (client->recv_buf == RT_NULL)
+                return status | CLIENT_RX_STARVED;
+        }
+
+        if (client->frame_state.end > 0 || client->recv_len > client->frame_state.size)
+        {
+            end = client->frame_state.end;
+            if (end == 0)
+            {
+                end = uart_client_frame_scan(client);
+                if (client->frame_state.flags & UART_FRAME_STATE_ABORTED)
+                {
+                    client->frame_state.flags &= ~UART_FRAME_STATE_ABORTED;
+                    uart_client_stream_end(client, UART_FRAME_END_ERROR);
+                }
+            }
+            if (end > 0)
+            {
+                /* the bytes behind the frame need a second buffer, the frame stays put until one is free */
+                if (end < client->recv_len && client->frame_pool.block_free_count == 0
+                        && !uart_client_pool_wait(client, alloc_timeout))
+                {
+                    client->frame_state.end = end;
+                    return status | CLIENT_RX_STARVED;
+                }
+                len = client->frame_state.size;
+                rt_memset(&client->frame_state, 0x00, sizeof(client->frame_state));
+                /* HDLC style flags: the one closing this frame opens the next */
+                if (client->frame_cfg.mode == UART_FRAME_DELIMITER
+                        && client->frame_cfg.param.delimiter.start == client->frame_cfg.param.delimiter.end)
+                {
+                    client->frame_state.flags = UART_FRAME_STATE_IN_FRAME;
+                }
+                uart_client_rx_dispatch(client, len, end, UART_FRAME_END_DELIMITER, alloc_timeout);
+                continue;
+            }
+            client->recv_len = client->frame_state.size;
+        }
+
+        if (client->recv_len == client->recv_buf_size - 1)
+        {
+            if (client->stream_handler)
+            {
+                /* the framer state is kept, only the decoded bytes leave recv_buf */
+                uart_client_stream_chunk(client, client->recv_buf, client->recv_len);
+                client->recv_len = client->frame_state.size = 0;
+            }
+            else
+            {
+                /* no room left, deliver what the framer has */
+                client->stats.truncated++;
+                len = client->frame_state.size;
+                rt_memset(&client->frame_state, 0x00, sizeof(client->frame_state));
+                uart_client_rx_dispatch(client, len, client->recv_len, UART_FRAME_END_ERROR, alloc_timeout);
+            }
+            continue;
+        }
+
+        /* cleared before reading, so data that arrives after the read raises a new notice */
+        client->rx_pending = RT_FALSE;
+        len = rt_device_read(client->device, 0, &client->recv_buf[client->recv_len],
+                client->recv_buf_size - 1 - client->recv_len);
+        if (len > 0)
+        {
+            uart_client_capture_rx(client, &client->recv_buf[client->recv_len], len);
+            client->stats.rx_bytes += len;
+            client->recv_len += len;
+            status |= CLIENT_RX_READ;
+            idle = RT_FALSE;
+            continue;
+        }
+
+        if (idle)
+        {
+            if (client->recv_len > 0)
+            {
+                len = client->frame_state.size;
+                rt_memset(&client->frame_state, 0x00, sizeof(client->frame_state));
+                uart_client_rx_dispatch(client, len, client->recv_len, UART_FRAME_END_IDLE, alloc_timeout);
+            }
+            else
+            {
+                rt_memset(&client->frame_state, 0x00, sizeof(client->frame_state));
+                if (client->stream_len > 0)
+                {
+                    /* a streamed frame that ended exactly on a chunk boundary */
+                    client->stats.rx_frames++;
+                    client->stats.handled++;
+                    uart_client_stream_end(client, UART_FRAME_END_IDLE);
+                }
+            }
+        }
+        return status;
+    }
+}
+
+/* How long the line may stay quiet before the open frame ends, forever if none is open */
+static rt_int32_t uart_client_rx_timeout(uart_client_t client)
+{
+    if (client->recv_len > 0 || client->stream_len > 0 || client->frame_state.flags)
+        return uart_client_frame_timeout(client);
+    return RT_WAITING_FOREVER;
+}
+
+/* Priority of the threads serving a client, later clients share the lowest one above idle */
+static rt_uint8_t uart_client_priority(rt_uint16_t index)
+{
+    if (PKG_UART_CLIENT_PRIORITY_START + index < RT_THREAD_PRIORITY_MAX - 1)
+        return PKG_UART_CLIENT_PRIORITY_START + index;
+    return RT_THREAD_PRIORITY_MAX - 2;
+}
+
+/* Keep the receive step from running, waits for one in progress to finish */
+static void uart_client_rx_hold(uart_client_t client)
+{
+    rt_base_t level;
+
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        if (!(client->rx_flags & CLIENT_RX_BUSY))
+        {
+            client->rx_flags |= CLIENT_RX_BUSY;
+            rt_hw_interrupt_enable(level);
+            return;
+        }
+        rt_hw_interrupt_enable(level);
+        rt_thread_mdelay(1);
+    }
+}
+
+static void uart_client_rx_unhold(uart_client_t client)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    client->rx_flags &= ~CLIENT_RX_BUSY;
+    rt_hw_interrupt_enable(level);
+    /* catch up on whatever was indicated meanwhile */
+    uart_client_rx_notify(client);
+}
+
+#ifndef PKG_UART_CLIENT_USING_REACTOR
+static void client_parser(uart_client_t client)
+{
+    rt_bool_t idle = RT_FALSE, held;
+    rt_uint8_t status;
+    rt_base_t level;
+
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        held = (client->rx_flags & CLIENT_RX_BUSY) != 0;
+        if (!held)
+        {
+            /* the hardware gap timer ends a frame ahead of the tick timeout */
+            idle = idle || (client->rx_flags & CLIENT_RX_IDLE);
+            client->rx_flags = (client->rx_flags & ~CLIENT_RX_IDLE) | CLIENT_RX_BUSY;
+        }
+        rt_hw_interrupt_enable(level);
+
+        if (held)
+        {
+            /* uart_client_rx_unhold() wakes us up */
+            rt_sem_take(&client->rx_notice, RT_WAITING_FOREVER);
+            idle = RT_FALSE;
+            continue;
+        }
+        status = uart_client_rx_step(client, idle, rt_tick_from_millisecond(PKG_UART_CLIENT_RX_WATCHDOG_MS));
+
+        level = rt_hw_interrupt_disable();
+        client->rx_flags &= ~CLIENT_RX_BUSY;
+        rt_hw_interrupt_enable(level);
+
+        if (status & CLIENT_RX_STARVED)
+        {
+            /* the step waited for a buffer already; retry without losing an idle line */
+            uart_client_end_watchdog(client);
+            idle = idle && !(status & CLIENT_RX_READ);
+            continue;
+        }
+        idle = (rt_sem_take(&client->rx_notice, uart_client_rx_timeout(client)) != RT_EOK);
+    }
+}
+#else
+/* Frame timeout expired: let a worker end the open frame */
+static void uart_client_idle_timeout(uart_client_t client)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    client->rx_flags |= CLIENT_RX_IDLE;
+    rt_hw_interrupt_enable(level);
+    rt_event_send(&uart_client_reactor, CLIENT_REACTOR_BIT(client));
+}
+
+/* Run the receive step for one client; if another worker has it, that worker runs it once more */
+static void uart_client_reactor_service(int index)
+{
+    uart_client_t client;
+    rt_uint8_t status;
+    rt_bool_t idle, again;
+    rt_int32_t timeout;
+    rt_base_t level;
+
+    /* looked up under the lock so a client being deleted is either gone or seen busy */
+    level = rt_hw_interrupt_disable();
+    client = uart_client_list[index];
+    if (client == RT_NULL)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    if (client->rx_flags & CLIENT_RX_BUSY)
+    {
+        client->rx_flags |= CLIENT_REACTOR_AGAIN;
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    client->rx_flags |= CLIENT_RX_BUSY;
+    rt_hw_interrupt_enable(level);
+
+    do
+    {
+        level = rt_hw_interrupt_disable();
+        idle = (client->rx_flags & CLIENT_RX_IDLE) != 0;
+        client->rx_flags &= ~(CLIENT_RX_IDLE | CLIENT_REACTOR_AGAIN);
+        rt_hw_interrupt_enable(level);
+
+        status = uart_client_rx_step(client, idle, 0);
+        if (status & CLIENT_RX_STARVED)
+        {
+            uart_client_end_watchdog(client);
+        }
+
+        /* the idle timer runs while a frame is open and restarts with every read */
+        timeout = uart_client_rx_timeout(client);
+        if (timeout == RT_WAITING_FOREVER)
+        {
+            rt_timer_stop(&client->idle_timer);
+        }
+        else if (status & CLIENT_RX_READ)
+        {
+            rt_timer_control(&client->idle_timer, RT_TIMER_CTRL_SET_TIME, &timeout);
+            rt_timer_start(&client->idle_timer);
+        }
+
+        level = rt_hw_interrupt_disable();
+        if (status & CLIENT_RX_STARVED)
+        {
+            uart_client_reactor_starved |= CLIENT_REACTOR_BIT(client);
+            if (idle && !(status & CLIENT_RX_READ))
+            {
+                client->rx_flags |= CLIENT_RX_IDLE;
+            }
+        }
+        again = (client->rx_flags & CLIENT_REACTOR_AGAIN) != 0;
+        if (!again)
+        {
+            client->rx_flags &= ~CLIENT_RX_BUSY;
+        }
+        rt_hw_interrupt_enable(level);
+    } while (again);
+}
+
+static void client_worker(void *parameter)
+{
+    rt_uint32_t set;
+    rt_base_t level;
+    int bit, i;
+
+    while (1)
+    {
+        if (rt_event_recv(&uart_client_reactor, 0xFFFFFFFF, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                uart_client_reactor_starved ? 1 : RT_WAITING_FOREVER, &set) != RT_EOK)
+        {
+            set = 0;
+        }
+
+        level = rt_hw_interrupt_disable();
+        set |= uart_client_reactor_starved;
+        uart_client_reactor_starved = 0;
+        rt_hw_interrupt_enable(level);
+
+        /* clients share a bit every 32 indexes, serve all of them */
+        while (set)
+        {
+            bit = __rt_ffs(set) - 1;
+            set &= ~(1UL << bit);
+            for (i = bit; i < PKG_UART_CLIENT_MAX_COUNT; i += 32)
+            {
+                uart_client_reactor_service(i);
+            }
+        }
+    }
+}
+
+static void uart_client_reactor_init(void)
+{
+    static rt_bool_t inited = RT_FALSE;
+    char name[RT_NAME_MAX];
+    int i;
+
+    if (inited)
+        return;
+
+    rt_event_init(&uart_client_reactor, CLIENT_REACTOR_NAME, RT_IPC_FLAG_FIFO);
+    for (i = 0; i < PKG_UART_CLIENT_REACTOR_WORKERS; i++)
+    {
+        rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_WORKER_NAME, i);
+        rt_thread_init(&uart_client_workers[i], name, client_worker, RT_NULL, uart_client_worker_stack[i],
+                sizeof(uart_client_worker_stack[i]), PKG_UART_CLIENT_PRIORITY_START, 20);
+        rt_thread_startup(&uart_client_workers[i]);
+    }
+    inited = RT_TRUE;
+}
+#endif
+
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+static void send_interval_timeout(uart_client_t client)
+{
+    rt_sem_release(&client->tx_sem);
+}
+#endif
+
+/* Select how the end of a frame is detected, frame_timeout_ms stays in effect as a fallback */
+rt_err_t uart_client_set_framing(uart_client_t client, const struct uart_frame_config *cfg)
+{
+    rt_uint8_t terminator_next[PKG_UART_CLIENT_TERMINATOR_MAX];
+    rt_size_t terminator_len = 0, i, k;
+
+    if (client == RT_NULL || cfg == RT_NULL)
+        return -RT_EINVAL;
+    /* modes left out of PKG_UART_CLIENT_FRAME_MODES have no framer */
+    if (cfg->mode != UART_FRAME_IDLE && !(PKG_UART_CLIENT_FRAME_MODES & (1UL << cfg->mode)))
+        return -RT_ENOSYS;
+
+    switch (cfg->mode)
+    {
+    case UART_FRAME_LENGTH:
+        if (cfg->param.length.size == 0 || cfg->param.length.size > sizeof(rt_uint32_t))
+            return -RT_EINVAL;
+        break;
+    case UART_FRAME_TERMINATOR:
+        if (cfg->param.terminator == RT_NULL)
+            return -RT_EINVAL;
+        terminator_len = rt_strlen(cfg->param.terminator);
+        if (terminator_len == 0 || terminator_len > PKG_UART_CLIENT_TERMINATOR_MAX)
+            return -RT_EINVAL;
+        /* terminator_next[i]: length of the longest proper prefix that ends terminator[0..i] */
+        terminator_next[0] = 0;
+        for (i = 1, k = 0; i < terminator_len; i++)
+        {
+            while (k > 0 && cfg->param.terminator[i] != cfg->param.terminator[k])
+                k = terminator_next[k - 1];
+            if (cfg->param.terminator[i] == cfg->param.terminator[k])
+                k++;
+            terminator_next[i] = k;
+        }
+        break;
+    case UART_FRAME_USER:
+        if (cfg->param.check == RT_NULL)
+            return -RT_EINVAL;
+        break;
+    default:
+        break;
+    }
+
+    rt_enter_critical();
+    client->frame_cfg = *cfg;
+    client->terminator_len = terminator_len;
+    if (terminator_len > 0)
+    {
+        rt_memcpy(client->terminator_next, terminator_next, terminator_len);
+    }
+    rt_exit_critical();
+
+    return RT_EOK;
+}
+
+void uart_client_set_frame_handler(uart_client_t client, rt_uint32_t frame_timeout_ms,
+        void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
+{
+    if (client == RT_NULL)
+        return;
+
+    client->frame_handler = frame_handler;
+    client->frame_timeout_ms = frame_timeout_ms;
+}
+
+/* Deliver unsolicited frames in pieces instead of through frame_handler, RT_NULL to switch back */
+void uart_client_set_stream_handler(uart_client_t client, const struct uart_stream_handler *handler)
+{
+    if (client == RT_NULL)
+        return;
+
+    client->stream_handler = handler;
+}
+
+#ifdef RT_USING_HWTIMER
+static rt_err_t uart_client_gap_timeout(rt_device_t dev, rt_size_t size)
+{
+    uart_client_t client = dev->user_data;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    client->rx_flags |= CLIENT_RX_IDLE;
+    rt_hw_interrupt_enable(level);
+    uart_client_rx_notify(client);
+
+    return RT_EOK;
+}
+
+/*
+ * Time the gap that ends a frame in Modbus RTU and automatic timeout mode with a
+ * hardware timer, restarted by every receive indication, instead of OS ticks.
+ * The tick timeout stays as a fallback. RT_NULL releases the timer.
+ */
+rt_err_t uart_client_set_gap_timer(uart_client_t client, const char *timer_name)
+{
+    rt_hwtimer_mode_t mode = HWTIMER_MODE_ONESHOT;
+    rt_device_t timer = RT_NULL, old;
+    rt_base_t level;
 
-    client = rt_calloc(1, sizeof(struct uart_client));
     if (client == RT_NULL)
+        return -RT_EEMPTY;
+
+    if (timer_name)
+    {
+        timer = rt_device_find(timer_name);
+        if (timer == RT_NULL || timer->type != RT_Device_Class_Timer)
+        {
+            LOG_E("uart client(%s) not find the hwtimer(%s).", client->device->parent.name, timer_name);
+            return -RT_ERROR;
+        }
+        if (rt_device_open(timer, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+        {
+            LOG_E("uart client(%s) open hwtimer(%s) failed.", client->device->parent.name, timer_name);
+            return -RT_EIO;
+        }
+        timer->user_data = client;
+        rt_device_set_rx_indicate(timer, uart_client_gap_timeout);
+        rt_device_control(timer, HWTIMER_CTRL_MODE_SET, &mode);
+    }
+
+    level = rt_hw_interrupt_disable();
+    old = client->gap_timer;
+    client->gap_timer = timer;
+    rt_hw_interrupt_enable(level);
+
+    if (old)
     {
-        LOG_E("uart client(%s) failure to create! no memory for uart client.", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        rt_device_control(old, HWTIMER_CTRL_STOP, RT_NULL);
+        rt_device_set_rx_indicate(old, RT_NULL);
+        rt_device_close(old);
     }
 
-    client->resp.buf = RT_NULL;
-    client->resp.buf_size = 0;
-    client->resp.timeout = 0;
-    client->resp_consume = RT_FALSE;
-    client->parser = RT_NULL;
+    return RT_EOK;
+}
+#endif
 
-    client->frame_timeout_ms = frame_timeout_ms;
-    client->frame_handler = frame_handler;
+static void client_sender(uart_client_t client)
+{
+    struct uart_tx_queue *queue = client->tx_queue;
+    struct uart_tx_msg *msg;
+    while (1)
+    {
+        if (rt_mb_recv(queue->mb, (rt_ubase_t *) &msg, RT_WAITING_FOREVER) == RT_EOK)
+        {
+            /* send_interval_ms pacing blocks this thread instead of the application */
+            uart_client_request_no_response(client, (rt_uint8_t *) (msg + 1), msg->size);
+            queue->stat.sent++;
+            rt_mp_free(msg);
+        }
+    }
+}
+
+/* Create the transmit queue drained by a sender thread; msg_size bounds one request, depth the queue */
+rt_err_t uart_client_tx_queue_create(uart_client_t client, rt_size_t msg_size, rt_size_t depth,
+        enum uart_tx_overflow policy, rt_uint32_t block_ms)
+{
+    struct uart_tx_queue *queue;
+    char name[RT_NAME_MAX];
+    rt_err_t result = RT_EOK;
+
+    if (client == RT_NULL || msg_size == 0 || depth == 0)
+        return -RT_EINVAL;
+    if (client->tx_queue)
+        return -RT_EBUSY;
+
+    queue = rt_calloc(1, sizeof(struct uart_tx_queue));
+    if (queue == RT_NULL)
+    {
+        LOG_E("uart client(%s) no memory for tx queue!", client->device->parent.name);
+        return -RT_ENOMEM;
+    }
+    queue->msg_size = msg_size;
+    queue->policy = policy;
+    queue->block_ticks = rt_tick_from_millisecond(block_ms);
 
-    client->recv_buf = (rt_uint8_t *) rt_calloc(1, recv_buf_size);
-    if (client->recv_buf == RT_NULL)
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TXMP_NAME, client->index);
+    queue->pool = rt_mp_create(name, depth, sizeof(struct uart_tx_msg) + msg_size);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TXMB_NAME, client->index);
+    queue->mb = rt_mb_create(name, depth, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TXTHREAD_NAME, client->index);
+    queue->sender = rt_thread_create(name, (void (*)(void *parameter)) client_sender, client,
+            PKG_UART_CLIENT_THREAD_STACK_SIZE, uart_client_priority(client->index), 20);
+    if (queue->pool == RT_NULL || queue->mb == RT_NULL || queue->sender == RT_NULL)
     {
-        LOG_E("uart client(%s) failure to create! no memory for ringbuffer pool.", dev_name);
+        LOG_E("uart client(%s) tx queue create failed!", client->device->parent.name);
         result = -RT_ENOMEM;
         goto __exit;
     }
-    client->recv_buf_size = recv_buf_size;
-    if (send_interval_ms > 0)
+
+    client->tx_queue = queue;
+    rt_thread_startup(queue->sender);
+
+    __exit: if (result != RT_EOK)
     {
-        rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TIME_NAME, client_num);
-        client->send_interval_timer = rt_timer_create(name, (void (*)(void *params)) send_interval_timeout, client,
-                rt_tick_from_millisecond(send_interval_ms),
-                RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
-        if (client->send_interval_timer == RT_NULL)
+        if (queue->pool)
+        {
+            rt_mp_delete(queue->pool);
+        }
+        if (queue->mb)
+        {
+            rt_mb_delete(queue->mb);
+        }
+        if (queue->sender)
         {
-            LOG_E("uart client(%s) failure to create! uart_client_timer create failed!", dev_name);
-            result = -RT_ENOMEM;
-            goto __exit;
+            rt_thread_delete(queue->sender);
         }
+        rt_free(queue);
     }
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_LOCK_NAME, client_num);
-    client->lock = rt_mutex_create(name, RT_IPC_FLAG_FIFO);
-    if (client->lock == RT_NULL)
+    return result;
+}
+
+/* Queue a request for the sender thread and return at once, the data is copied */
+rt_err_t uart_client_request_enqueue(uart_client_t client, const rt_uint8_t *req_buf, rt_size_t req_size)
+{
+    struct uart_tx_queue *queue;
+    struct uart_tx_msg *msg;
+
+    if (client == RT_NULL || client->tx_queue == RT_NULL)
+        return -RT_EEMPTY;
+
+    queue = client->tx_queue;
+    if (req_size > queue->msg_size)
+        return -RT_EINVAL;
+
+    msg = rt_mp_alloc(queue->pool, 0);
+    if (msg == RT_NULL)
     {
-        LOG_E("uart client(%s) failure to create! uart_client_lock create failed!", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        switch (queue->policy)
+        {
+        case UART_TX_DROP_OLDEST:
+            /* reuse the oldest queued request, unless the sender just took it */
+            if (rt_mb_recv(queue->mb, (rt_ubase_t *) &msg, 0) == RT_EOK)
+            {
+                queue->stat.dropped++;
+            }
+            else
+            {
+                msg = rt_mp_alloc(queue->pool, 0);
+            }
+            break;
+        case UART_TX_BLOCK:
+            msg = rt_mp_alloc(queue->pool, queue->block_ticks);
+            break;
+        default:
+            break;
+        }
+        if (msg == RT_NULL)
+        {
+            queue->stat.dropped++;
+            return -RT_EFULL;
+        }
     }
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TXSEM_NAME, client_num);
-    client->tx_sem = rt_sem_create(name, 1, RT_IPC_FLAG_FIFO);
-    if (client->tx_sem == RT_NULL)
+    msg->size = req_size;
+    rt_memcpy(msg + 1, req_buf, req_size);
+    /* one mailbox slot per pool block, this cannot fail */
+    rt_mb_send(queue->mb, (rt_ubase_t) msg);
+    queue->stat.enqueued++;
+    if (queue->mb->entry > queue->stat.peak)
     {
-        LOG_E("uart client(%s) failure to create! uart_client_tx_sem create failed!", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        queue->stat.peak = queue->mb->entry;
+    }
+
+    return RT_EOK;
+}
+
+void uart_client_tx_queue_stat(uart_client_t client, struct uart_tx_queue_stat *stat)
+{
+    if (client == RT_NULL || client->tx_queue == RT_NULL || stat == RT_NULL)
+        return;
+
+    *stat = client->tx_queue->stat;
+    stat->depth = client->tx_queue->mb->entry;
+}
+
+void uart_client_get_stats(uart_client_t client, struct uart_client_stats *stats)
+{
+    if (client == RT_NULL || stats == RT_NULL)
+        return;
+
+    *stats = client->stats;
+}
+
+void uart_client_reset_stats(uart_client_t client)
+{
+    if (client == RT_NULL)
+        return;
+
+    rt_memset(&client->stats, 0x00, sizeof(client->stats));
+}
+
+/*
+ * Initialize a client in caller provided memory, nothing is taken from the heap.
+ * pool holds the frame buffers and needs UART_CLIENT_POOL_SIZE(recv_buf_size)
+ * bytes, stack is the parser thread stack and unused in reactor mode.
+ */
+rt_err_t uart_client_init(uart_client_t client, const char *dev_name, void *pool, rt_size_t pool_size,
+        rt_size_t recv_buf_size, void *stack, rt_size_t stack_size, rt_uint32_t send_interval_ms,
+        rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
+{
+    char name[RT_NAME_MAX];
+    rt_err_t open_result = RT_EOK;
+    rt_device_t device;
+    int index, lane;
+
+    RT_ASSERT(client);RT_ASSERT(dev_name);RT_ASSERT(pool);RT_ASSERT(recv_buf_size > 1);
+#ifndef PKG_UART_CLIENT_USING_REACTOR
+    RT_ASSERT(stack);
+#endif
+
+    /* slots of deleted clients are reused */
+    for (index = 0; index < PKG_UART_CLIENT_MAX_COUNT && uart_client_list[index]; index++);
+    if (index >= PKG_UART_CLIENT_MAX_COUNT)
+    {
+        LOG_E("uart client(%s) failure to create! too many uart clients.", dev_name);
+        return -RT_EFULL;
+    }
+    if (pool_size < UART_CLIENT_POOL_SIZE(recv_buf_size))
+    {
+        LOG_E("uart client(%s) failure to create! frame pool of %d bytes is too small.", dev_name, pool_size);
+        return -RT_EINVAL;
+    }
+    device = rt_device_find(dev_name);
+    if (device == RT_NULL)
+    {
+        LOG_E("uart client failure to create! not find the device(%s).", dev_name);
+        return -RT_ERROR;
     }
+    RT_ASSERT(device->type == RT_Device_Class_Char);
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_SEM_NAME, client_num);
-    client->rx_notice = rt_sem_create(name, 0, RT_IPC_FLAG_FIFO);
-    if (client->rx_notice == RT_NULL)
+    rt_memset(client, 0, sizeof(struct uart_client));
+    client->device = device;
+    client->index = index;
+    client->is_static = RT_TRUE;
+    client->recv_buf_size = recv_buf_size;
+    client->frame_timeout_ms = frame_timeout_ms;
+    client->frame_handler = frame_handler;
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+    client->send_interval = rt_tick_from_millisecond(send_interval_ms);
+#else
+    RT_ASSERT(send_interval_ms == 0);
+#endif
+    rt_list_init(&client->trans_list);
+
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_MP_NAME, index);
+    rt_mp_init(&client->frame_pool, name, pool, pool_size, recv_buf_size);
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TIME_NAME, index);
+    rt_timer_init(&client->send_interval_timer, name, (void (*)(void *params)) send_interval_timeout, client,
+            client->send_interval, RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+#endif
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_LANE_NAME, index);
+    for (lane = UART_LANE_HIGH; lane < UART_LANE_NUM; lane++)
     {
-        LOG_E("uart client(%s) failure to create! uart_client_notice semaphore create failed!", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        rt_sem_init(&client->lane_grant[lane], name, 0, RT_IPC_FLAG_FIFO);
     }
+#ifdef UART_CLIENT_USING_DE_PIN
+    client->de_pin = -1;
+#ifdef RT_USING_HWTIMER
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_DE_NAME, index);
+    rt_sem_init(&client->de_done, name, 0, RT_IPC_FLAG_FIFO);
+#endif
+#endif
+    /* every thread in the normal lane until uart_client_set_lanes() */
+    client->lane_bulk_prio = RT_THREAD_PRIORITY_MAX - 1;
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_TXSEM_NAME, index);
+    rt_sem_init(&client->tx_sem, name, 1, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_SEM_RESP_NAME, index);
+    rt_sem_init(&client->resp_notice, name, 0, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_HANDLER_NAME, index);
+    rt_mutex_init(&client->handler_lock, name, RT_IPC_FLAG_PRIO);
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_IDLE_NAME, index);
+    rt_timer_init(&client->idle_timer, name, (void (*)(void *params)) uart_client_idle_timeout, client, 1,
+            RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+    uart_client_reactor_init();
+#else
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_SEM_NAME, index);
+    rt_sem_init(&client->rx_notice, name, 0, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_THREAD_NAME, index);
+    rt_thread_init(&client->parser, name, (void (*)(void *parameter)) client_parser, client, stack, stack_size,
+            uart_client_priority(index), 20);
+#endif
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_SEM_RESP_NAME, client_num);
-    client->resp_notice = rt_sem_create(name, 0, RT_IPC_FLAG_FIFO);
-    if (client->resp_notice == RT_NULL)
+#ifdef RT_USING_SERIAL_V2
+    open_result = rt_device_open(device, RT_DEVICE_FLAG_RX_NON_BLOCKING | RT_DEVICE_FLAG_TX_BLOCKING);
+#else
+#if defined(RT_SERIAL_USING_DMA) && !defined(PKG_UART_CLIENT_USING_INT_RX)
+    /* using DMA mode first */
+    open_result = rt_device_open(device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_DMA_RX);
+    /* using interrupt mode when DMA mode not supported */
+    if (open_result == RT_EOK)
     {
-        LOG_E("uart client(%s) failure to create! uart_client_resp semaphore create failed!", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        LOG_I("uart client(%s) using DMA mode!", dev_name);
+    }
+    else if (open_result == -RT_EIO)
+#endif
+    {
+        open_result = rt_device_open(device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
     }
+#endif
+    RT_ASSERT(open_result == RT_EOK);
+    rt_device_set_rx_indicate(device, uart_client_rx_ind);
+
+    uart_client_register(client);
+#ifndef PKG_UART_CLIENT_USING_REACTOR
+    rt_thread_startup(&client->parser);
+#endif
+    /* pick up whatever arrived before the client was registered */
+    uart_client_rx_notify(client);
+    LOG_I("uart client on device %s create success.", dev_name);
+
+    return RT_EOK;
+}
+
+uart_client_t uart_client_create(const char *dev_name, rt_size_t recv_buf_size, rt_uint32_t send_interval_ms,
+        rt_uint32_t frame_timeout_ms, void (*frame_handler)(rt_uint8_t *frame_data, rt_size_t size))
+{
+    rt_size_t client_size = RT_ALIGN(sizeof(struct uart_client), RT_ALIGN_SIZE);
+    rt_size_t pool_size = RT_ALIGN(UART_CLIENT_POOL_SIZE(recv_buf_size), RT_ALIGN_SIZE);
+    rt_size_t stack_size = 0;
+    rt_uint8_t *stack = RT_NULL;
+    uart_client_t client;
+    rt_err_t result;
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_SEM_RESP_END_NAME, client_num);
-    client->resp_end_notice = rt_sem_create(name, 0, RT_IPC_FLAG_FIFO);
-    if (client->resp_end_notice == RT_NULL)
+    RT_ASSERT(dev_name);RT_ASSERT(recv_buf_size > 1);
+
+#ifndef PKG_UART_CLIENT_USING_REACTOR
+    stack_size = PKG_UART_CLIENT_THREAD_STACK_SIZE;
+#endif
+    /* control block, frame pool and parser stack share one allocation */
+    client = rt_malloc(client_size + pool_size + stack_size);
+    if (client == RT_NULL)
     {
-        LOG_E("uart client(%s) failure to create! uart_client_resp_end semaphore create failed!", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        LOG_E("uart client(%s) failure to create! no memory for uart client.", dev_name);
+        return RT_NULL;
+    }
+    if (stack_size > 0)
+    {
+        stack = (rt_uint8_t *) client + client_size + pool_size;
     }
 
-    client->device = rt_device_find(dev_name);
-    if (client->device)
+    result = uart_client_init(client, dev_name, (rt_uint8_t *) client + client_size, pool_size, recv_buf_size,
+            stack, stack_size, send_interval_ms, frame_timeout_ms, frame_handler);
+    if (result != RT_EOK)
     {
-        RT_ASSERT(client->device->type == RT_Device_Class_Char);
-#ifdef RT_USING_SERIAL_V2
-        open_result = rt_device_open(client->device, RT_DEVICE_FLAG_RX_NON_BLOCKING | RT_DEVICE_FLAG_TX_BLOCKING);
+        LOG_E("uart client on device %s initialize failed(%d).", dev_name, result);
+        rt_free(client);
+        return RT_NULL;
+    }
+    client->is_static = RT_FALSE;
+
+    return client;
+}
+
+/* Stop the client and release everything but the control block */
+static void uart_client_stop(uart_client_t client)
+{
+    uart_transaction_t trans;
+    rt_base_t level;
+    int lane;
+
+    /* no request in flight and the send interval of the last one has passed */
+    uart_client_lane_take(client, UART_LANE_HIGH);
+    rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+#ifndef PKG_UART_CLIENT_WITHOUT_SEND_INTERVAL
+    rt_timer_detach(&client->send_interval_timer);
+#endif
+
+    rt_device_set_rx_indicate(client->device, RT_NULL);
+    uart_client_unregister(client);
+#ifdef RT_USING_HWTIMER
+    uart_client_set_gap_timer(client, RT_NULL);
+#ifdef UART_CLIENT_USING_DE_PIN
+    uart_client_de_timer_swap(client, RT_NULL);
+    rt_sem_detach(&client->de_done);
+#endif
+#endif
+    uart_client_rx_hold(client);
+#ifdef PKG_UART_CLIENT_USING_REACTOR
+    rt_timer_detach(&client->idle_timer);
 #else
-#ifdef RT_SERIAL_USING_DMA
-        /* using DMA mode first */
-        open_result = rt_device_open(client->device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_DMA_RX);
-        /* using interrupt mode when DMA mode not supported */
-        if (open_result == RT_EOK)
-        {
-            LOG_I("uart client(%s) using DMA mode!", dev_name);
-            rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_MB_NAME, client_num);
-            client->rx_mb = rt_mb_create(name, 64, RT_IPC_FLAG_FIFO);
-            if (client->rx_mb == RT_NULL)
-            {
-                LOG_E("uart client(%s) failure to create! uart_client_notice mailbox create failed!", dev_name);
-                result = -RT_ENOMEM;
-                goto __exit;
-            }
-        }
-        else if (open_result == -RT_EIO)
+    /* held, so the parser is parked on rx_notice and owns nothing */
+    rt_thread_detach(&client->parser);
+    rt_sem_detach(&client->rx_notice);
 #endif
+    rt_device_close(client->device);
+
+    if (client->tx_queue)
+    {
+        /* the sender waits on its mailbox or in its lane */
+        rt_thread_delete(client->tx_queue->sender);
+        rt_mb_delete(client->tx_queue->mb);
+        rt_mp_delete(client->tx_queue->pool);
+        rt_free(client->tx_queue);
+        client->tx_queue = RT_NULL;
+    }
+
+    /* fail the outstanding transactions, request_wait() returns at once */
+    level = rt_hw_interrupt_disable();
+    while (!rt_list_isempty(&client->trans_list))
+    {
+        trans = rt_list_entry(client->trans_list.next, struct uart_transaction, list);
+        rt_list_remove(&trans->list);
+        trans->result = -RT_ERROR;
+        rt_sem_release(&trans->done);
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (client->stream_len > 0)
+    {
+        uart_client_stream_end(client, UART_FRAME_END_ERROR);
+    }
+    rt_mp_detach(&client->frame_pool);
+    if (client->pool_alloc)
+    {
+        rt_free(client->pool_alloc);
+        client->pool_alloc = RT_NULL;
+    }
+    rt_sem_detach(&client->resp_notice);
+    rt_mutex_detach(&client->handler_lock);
+    rt_sem_detach(&client->tx_sem);
+    /* still owned, whatever waits in a lane is a thread that should not use the client any more */
+    for (lane = UART_LANE_HIGH; lane < UART_LANE_NUM; lane++)
+    {
+        rt_sem_detach(&client->lane_grant[lane]);
+    }
+    LOG_I("uart client on device %s deleted.", client->device->parent.name);
+}
+
+/*
+ * Stop a client from uart_client_create() and free it. Waits for the request in
+ * progress; no other thread may use the client once this is called, and it must
+ * not be called from the client's own handlers.
+ */
+rt_err_t uart_client_delete(uart_client_t client)
+{
+    if (client == RT_NULL)
+        return -RT_EEMPTY;
+    RT_ASSERT(client->is_static == RT_FALSE);
+
+    uart_client_stop(client);
+    rt_free(client);
+
+    return RT_EOK;
+}
+
+/* Stop a client from uart_client_init(), its memory is the caller's again afterwards */
+rt_err_t uart_client_detach(uart_client_t client)
+{
+    if (client == RT_NULL)
+        return -RT_EEMPTY;
+    RT_ASSERT(client->is_static == RT_TRUE);
+
+    uart_client_stop(client);
+
+    return RT_EOK;
+}
+
+/* Rebuild the frame pool for recv_buf_size, growing onto the heap only for created clients */
+static rt_err_t uart_client_pool_resize(uart_client_t client, rt_size_t recv_buf_size)
+{
+    struct rt_mempool *pool = &client->frame_pool;
+    rt_size_t size = UART_CLIENT_POOL_SIZE(recv_buf_size);
+    void *start = pool->start_address, *grown = RT_NULL;
+    char name[RT_NAME_MAX];
+
+    if (pool->block_free_count != pool->block_total_count)
+        return -RT_EBUSY;
+
+    if (size > pool->size)
+    {
+        if (client->is_static)
         {
-            open_result = rt_device_open(client->device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
+            LOG_E("uart client(%s) frame pool of %d bytes is too small!", client->device->parent.name, pool->size);
+            return -RT_EINVAL;
         }
-#endif
-        RT_ASSERT(open_result == RT_EOK);
-
-        rt_device_set_rx_indicate(client->device, uart_client_rx_ind);
+        grown = rt_malloc(size);
+        if (grown == RT_NULL)
+        {
+            LOG_E("uart client(%s) no memory for frame pool!", client->device->parent.name);
+            return -RT_ENOMEM;
+        }
+        start = grown;
     }
     else
     {
-        LOG_E("uart client failure to create! not find the device(%s).", dev_name);
-        result = -RT_ERROR;
-        goto __exit;
+        size = pool->size;
     }
 
-    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_THREAD_NAME, client_num);
-    client->parser = rt_thread_create(name, (void (*)(void *parameter)) client_parser, client,
-    PKG_UART_CLIENT_THREAD_STACK_SIZE,
-    PKG_UART_CLIENT_PRIORITY_START + client_num, 20);
-    if (client->parser == RT_NULL)
+    rt_mp_detach(pool);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CLIENT_MP_NAME, client->index);
+    rt_mp_init(pool, name, start, size, recv_buf_size);
+    if (grown)
     {
-        LOG_E("uart client(%s) failure to create! no memory for parser thread.", dev_name);
-        result = -RT_ENOMEM;
-        goto __exit;
+        rt_free(client->pool_alloc);
+        client->pool_alloc = grown;
+    }
+    client->recv_buf_size = recv_buf_size;
+
+    return RT_EOK;
+}
+
+/*
+ * Change the baud rate, receive buffer size and frame timeout of a running client,
+ * 0 keeps a setting. A frame timeout of 0 with a new baud rate scales the current
+ * one by the speed change, UART_CLIENT_FRAME_TIMEOUT_AUTO follows it by itself.
+ * Waits for the request in progress; a partially received frame is dropped.
+ */
+rt_err_t uart_client_reconfigure(uart_client_t client, rt_uint32_t baud_rate, rt_size_t recv_buf_size,
+        rt_uint32_t frame_timeout_ms)
+{
+    struct rt_serial_device *serial;
+    struct serial_configure config;
+    rt_uint32_t old_baud_rate;
+    rt_err_t result = RT_EOK;
+
+    if (client == RT_NULL)
+        return -RT_EEMPTY;
+    if (recv_buf_size == 1)
+        return -RT_EINVAL;
+
+    serial = (struct rt_serial_device *) client->device;
+    uart_client_lane_take(client, UART_LANE_HIGH);
+    rt_sem_take(&client->tx_sem, RT_WAITING_FOREVER);
+    uart_client_rx_hold(client);
+
+    if (client->stream_len > 0)
+    {
+        uart_client_stream_end(client, UART_FRAME_END_ERROR);
     }
+    if (client->recv_buf)
+    {
+        rt_mp_free(client->recv_buf);
+        client->recv_buf = RT_NULL;
+    }
+    client->recv_len = 0;
+    rt_memset(&client->frame_state, 0x00, sizeof(client->frame_state));
 
-    __exit: if (result == RT_EOK)
+    if (recv_buf_size > 0 && recv_buf_size != client->recv_buf_size)
     {
-        uart_client_list[client_num++] = client;
-        rt_thread_startup(client->parser);
-        LOG_I("uart client on device %s create success.", dev_name);
+        result = uart_client_pool_resize(client, recv_buf_size);
     }
-    else
+    if (result == RT_EOK && baud_rate > 0 && baud_rate != serial->config.baud_rate)
     {
-        if (client)
+        old_baud_rate = serial->config.baud_rate;
+        config = serial->config;
+        config.baud_rate = baud_rate;
+        result = rt_device_control(client->device, RT_DEVICE_CTRL_CONFIG, &config);
+        if (result == RT_EOK && frame_timeout_ms == 0 && client->frame_timeout_ms != UART_CLIENT_FRAME_TIMEOUT_AUTO)
         {
-            if (client->lock)
-            {
-                rt_mutex_delete(client->lock);
-            }
-            if (client->tx_sem)
-            {
-                rt_sem_delete(client->tx_sem);
-            }
-            if (client->rx_notice)
-            {
-                rt_sem_delete(client->rx_notice);
-            }
-            if (client->rx_mb)
-            {
-                rt_mb_delete(client->rx_mb);
-            }
-            if (client->resp_notice)
-            {
-                rt_sem_delete(client->resp_notice);
-            }
-            if (client->resp_end_notice)
-            {
-                rt_sem_delete(client->resp_end_notice);
-            }
-            if (client->recv_buf)
-            {
-                rt_free(client->recv_buf);
-                client->recv_buf = RT_NULL;
-            }
-            if (client->device)
-            {
-                rt_device_close(client->device);
-            }
-            if (client->parser)
-            {
-                rt_thread_delete(client->parser);
-            }
-            if (client->send_interval_timer)
-            {
-                rt_timer_delete(client->send_interval_timer);
-            }
+            /* rounded up to whole milliseconds */
+            frame_timeout_ms = (rt_uint32_t) (((rt_uint64_t) client->frame_timeout_ms * old_baud_rate
+                    + baud_rate - 1) / baud_rate);
+        }
+        if (result == RT_EOK)
+        {
+            /* measured at the old speed */
+            rt_memset(&client->rtt, 0x00, sizeof(client->rtt));
+        }
+    }
+    if (result == RT_EOK && frame_timeout_ms > 0)
+    {
+        client->frame_timeout_ms = frame_timeout_ms;
+    }
+
+    uart_client_rx_unhold(client);
+    rt_sem_release(&client->tx_sem);
+    uart_client_lane_release(client);
+
+    if (result != RT_EOK)
+    {
+        LOG_E("uart client(%s) reconfigure failed(%d).", client->device->parent.name, result);
+    }
+    return result;
+}
 
-            rt_free(client);
-            client = RT_NULL;
+#ifdef RT_USING_FINSH
+static void uart_client_stat_hist(const char *name, const rt_uint32_t *hist)
+{
+    rt_kprintf("  %s ticks:", name);
+    for (int i = 0; i < UART_CLIENT_HIST_BUCKETS; i++)
+    {
+        if (hist[i])
+        {
+            rt_kprintf(" <%d:%d", 1 << i, hist[i]);
         }
-        LOG_E("uart client on device %s initialize failed(%d).", dev_name, result);
     }
+    rt_kprintf("\n");
+}
 
-    return client;
+/* Dump the counters of every client, "-r" clears them afterwards */
+static void uart_client_stat(int argc, char **argv)
+{
+    static const char *const lane_names[UART_LANE_NUM] = { "high", "normal", "bulk" };
+    struct uart_client_stats stats;
+    rt_bool_t reset = (argc > 1 && rt_strcmp(argv[1], "-r") == 0);
+
+    for (int i = 0; i < PKG_UART_CLIENT_MAX_COUNT; i++)
+    {
+        if (uart_client_list[i] == RT_NULL)
+            continue;
+
+        uart_client_get_stats(uart_client_list[i], &stats);
+        rt_kprintf("uart client(%s):\n", uart_client_list[i]->device->parent.name);
+        rt_kprintf("  rx %d bytes %d frames, tx %d bytes %d frames\n", stats.rx_bytes, stats.rx_frames,
+                stats.tx_bytes, stats.tx_frames);
+        rt_kprintf("  requests %d, timeouts %d, retries %d, consumed %d, handled %d\n", stats.requests,
+                stats.timeouts, stats.retries, stats.consumed, stats.handled);
+        if (uart_client_list[i]->rtt.samples > 0)
+        {
+            rt_kprintf("  srtt %d ticks, rttvar %d ticks, rto %d ticks\n", uart_client_list[i]->rtt.srtt >> 3,
+                    uart_client_list[i]->rtt.rttvar >> 2, uart_rtt_rto(&uart_client_list[i]->rtt));
+        }
+        rt_kprintf("  truncated %d, coalesced rx notices %d, crc errors %d, missed request_end %d\n",
+                stats.truncated, stats.rx_coalesced, stats.rx_crc_errors, stats.end_reclaims);
+        uart_client_stat_hist("rtt ", stats.rtt_hist);
+        uart_client_stat_hist("wait", stats.wait_hist);
+        for (int lane = UART_LANE_HIGH; lane < UART_LANE_NUM; lane++)
+        {
+            if (stats.lanes[lane].requests || stats.lanes[lane].preempted)
+            {
+                rt_kprintf("  %s lane: requests %d, preempted %d, max wait %d ticks\n", lane_names[lane],
+                        stats.lanes[lane].requests, stats.lanes[lane].preempted, stats.lanes[lane].wait_max);
+                uart_client_stat_hist("wait", stats.lanes[lane].wait_hist);
+            }
+        }
+        if (reset)
+        {
+            uart_client_reset_stats(uart_client_list[i]);
+        }
+    }
 }
+MSH_CMD_EXPORT(uart_client_stat, dump uart client counters: [-r]);
+#endif
 
 #endif
@@ -0,0 +1,388 @@
+#include <rtthread.h>
+#include <uart_client_bus.h>
+
+#define DBG_TAG    "uart.bus"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+#define BUS_THREAD_NAME             "ucb"
+#define BUS_LOCK_NAME               "ucbl"
+#define BUS_WAKE_NAME               "ucbw"
+#define BUS_DONE_NAME               "ucbd"
+#define BUS_ROUND_NAME              "ucbr"
+
+#define BUS_DUE(now, due)           ((rt_int32_t) ((now) - (due)) >= 0)
+
+/*
+ * The bus thread keeps one poll table per client. Every round it takes the due
+ * slaves, most overdue first, and polls them back to back in a single batch,
+ * so the wire is held once and only the client's send interval separates the
+ * requests. The table is locked while the batch is built and while it is
+ * completed, not while it is on the wire. Each slave has its own round trip
+ * estimate: once it answered, its timeout is the estimated rto, doubled on
+ * every failure up to the configured timeout. After
+ * PKG_UART_CLIENT_BUS_OFFLINE_FAILS failures in a row, a slave is polled at
+ * doubling intervals until it answers again.
+ */
+
+static rt_uint32_t uart_bus_ticks_to_ms(rt_tick_t ticks)
+{
+    return (rt_uint32_t) (((rt_uint64_t) ticks * 1000 + RT_TICK_PER_SECOND - 1) / RT_TICK_PER_SECOND);
+}
+
+static rt_uint32_t uart_bus_timeout_ms(struct uart_bus_slave *slave)
+{
+    rt_tick_t rto = uart_rtt_rto(&slave->rtt);
+    rt_uint32_t timeout_ms;
+
+    if (rto == 0)
+        return slave->poll.timeout_ms;
+    timeout_ms = uart_bus_ticks_to_ms(rto);
+    if (timeout_ms < PKG_UART_CLIENT_BUS_MIN_TIMEOUT_MS)
+        timeout_ms = PKG_UART_CLIENT_BUS_MIN_TIMEOUT_MS;
+    if (timeout_ms > slave->poll.timeout_ms)
+        timeout_ms = slave->poll.timeout_ms;
+    return timeout_ms;
+}
+
+/* Fill the batch with the due slaves, most overdue first; *wait gets the time to the next one otherwise */
+static rt_size_t uart_bus_collect(uart_bus_t bus, rt_tick_t now, rt_int32_t *wait)
+{
+    struct uart_bus_slave *slave;
+    rt_size_t n = 0, i;
+    rt_int32_t left;
+    rt_list_t *node;
+
+    *wait = RT_WAITING_FOREVER;
+    rt_list_for_each(node, &bus->slaves)
+    {
+        slave = rt_list_entry(node, struct uart_bus_slave, list);
+        if (!BUS_DUE(now, slave->next_due))
+        {
+            left = (rt_int32_t) (slave->next_due - now);
+            if (*wait == RT_WAITING_FOREVER || left < *wait)
+            {
+                *wait = left;
+            }
+            continue;
+        }
+        for (i = n; i > 0 && (rt_int32_t) (bus->batch[i - 1]->next_due - slave->next_due) > 0; i--)
+        {
+            if (i < PKG_UART_CLIENT_BUS_BATCH)
+            {
+                bus->batch[i] = bus->batch[i - 1];
+            }
+        }
+        if (i < PKG_UART_CLIENT_BUS_BATCH)
+        {
+            bus->batch[i] = slave;
+            if (n < PKG_UART_CLIENT_BUS_BATCH)
+            {
+                n++;
+            }
+        }
+    }
+    /* due slaves left out of a full batch go in the next round */
+    if (n == PKG_UART_CLIENT_BUS_BATCH)
+    {
+        *wait = 0;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        slave = bus->batch[i];
+        if ((rt_tick_t) (now - slave->next_due) > rt_tick_from_millisecond(slave->poll.deadline_ms))
+        {
+            slave->stat.deadline_misses++;
+        }
+        bus->items[i].req_buf = slave->poll.req_buf;
+        bus->items[i].req_size = slave->poll.req_size;
+        bus->items[i].timeout_ms = uart_bus_timeout_ms(slave);
+        bus->items[i].resp_buf = slave->resp_buf;
+        bus->items[i].resp_buf_size = slave->resp_buf_size;
+    }
+    return n;
+}
+
+static void uart_bus_complete(struct uart_bus_slave *slave, struct uart_batch_item *item, rt_tick_t now)
+{
+    rt_tick_t period = rt_tick_from_millisecond(slave->poll.period_ms), interval;
+    rt_err_t result = item->result;
+    int shift;
+
+    slave->stat.polls++;
+    if (result == RT_EOK && (slave->poll.flags & UART_BUS_MATCH_ADDRESS)
+            && (item->resp_size == 0 || slave->resp_buf[0] != slave->poll.address))
+    {
+        slave->stat.mismatches++;
+        result = -RT_ERROR;
+    }
+
+    if (result == RT_EOK)
+    {
+        slave->stat.responses++;
+        slave->fail_streak = 0;
+        slave->stat.offline = RT_FALSE;
+        uart_rtt_update(&slave->rtt, item->rtt);
+    }
+    else
+    {
+        if (result == -RT_ETIMEOUT)
+        {
+            slave->stat.timeouts++;
+        }
+        slave->fail_streak++;
+        /* a slow answer is not told from none, the next poll waits twice as long */
+        uart_rtt_backoff(&slave->rtt);
+    }
+
+    if (slave->fail_streak >= PKG_UART_CLIENT_BUS_OFFLINE_FAILS)
+    {
+        if (!slave->stat.offline)
+        {
+            LOG_W("slave %d offline, backing off", slave->poll.address);
+            slave->stat.offline = RT_TRUE;
+        }
+        shift = slave->fail_streak - PKG_UART_CLIENT_BUS_OFFLINE_FAILS + 1;
+        interval = period << (shift < 16 ? shift : 16);
+        if (interval > rt_tick_from_millisecond(PKG_UART_CLIENT_BUS_BACKOFF_MAX_MS) || interval < period)
+        {
+            interval = rt_tick_from_millisecond(PKG_UART_CLIENT_BUS_BACKOFF_MAX_MS);
+        }
+        if (period > 0)
+        {
+            slave->stat.backoffs += interval / period - 1;
+        }
+        slave->next_due = now + interval;
+    }
+    else
+    {
+        /* keep the phase, but a late slave is not polled in a burst to catch up */
+        slave->next_due += period;
+        if (BUS_DUE(now, slave->next_due))
+        {
+            slave->next_due = now;
+        }
+    }
+
+    if (slave->handler)
+    {
+        slave->handler(slave, result, slave->resp_buf, result == RT_EOK ? item->resp_size : 0);
+    }
+}
+
+static void uart_bus_entry(void *parameter)
+{
+    uart_bus_t bus = parameter;
+    rt_err_t result;
+    rt_int32_t wait;
+    rt_size_t n, i;
+    rt_tick_t now;
+
+    while (!bus->stopping)
+    {
+        rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+        n = uart_bus_collect(bus, rt_tick_get(), &wait);
+        bus->polling = n;
+        rt_mutex_release(&bus->lock);
+        if (n > 0)
+        {
+            result = uart_client_request_batch_untimed(bus->client, bus->items, n);
+
+            rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+            /* a handler may remove its own slave */
+            bus->polling = 0;
+            /* preempted before reaching the wire, the slaves stay due for the next round */
+            if (result != -RT_EINTR)
+            {
+                now = rt_tick_get();
+                for (i = 0; i < n; i++)
+                {
+                    /* removed while on the wire */
+                    if (rt_list_isempty(&bus->batch[i]->list))
+                        continue;
+                    uart_bus_complete(bus->batch[i], &bus->items[i], now);
+                }
+            }
+            for (; bus->round_waiters > 0; bus->round_waiters--)
+            {
+                rt_sem_release(&bus->round);
+            }
+            rt_mutex_release(&bus->lock);
+        }
+        if (n == 0 && wait != 0)
+        {
+            rt_sem_take(&bus->wake, wait);
+        }
+    }
+    rt_sem_release(&bus->done);
+}
+
+/*
+ * Start a poll scheduler on the client, slaves are added with uart_bus_add(). The
+ * slaves are timed one by one, apart from the client's own auto timeout.
+ */
+uart_bus_t uart_bus_create(uart_client_t client)
+{
+    char name[RT_NAME_MAX];
+    uart_bus_t bus;
+
+    if (client == RT_NULL)
+    {
+        LOG_E("the uart client is null!");
+        return RT_NULL;
+    }
+
+    bus = rt_calloc(1, sizeof(struct uart_bus));
+    if (bus == RT_NULL)
+    {
+        LOG_E("uart client(%s) no memory for bus!", client->device->parent.name);
+        return RT_NULL;
+    }
+    bus->client = client;
+    rt_list_init(&bus->slaves);
+
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", BUS_LOCK_NAME, client->index);
+    rt_mutex_init(&bus->lock, name, RT_IPC_FLAG_PRIO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", BUS_WAKE_NAME, client->index);
+    rt_sem_init(&bus->wake, name, 0, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", BUS_DONE_NAME, client->index);
+    rt_sem_init(&bus->done, name, 0, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", BUS_ROUND_NAME, client->index);
+    rt_sem_init(&bus->round, name, 0, RT_IPC_FLAG_FIFO);
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", BUS_THREAD_NAME, client->index);
+    bus->thread = rt_thread_create(name, uart_bus_entry, bus, PKG_UART_CLIENT_THREAD_STACK_SIZE,
+            PKG_UART_CLIENT_BUS_PRIORITY, 20);
+    if (bus->thread == RT_NULL)
+    {
+        LOG_E("uart client(%s) bus thread create failed!", client->device->parent.name);
+        rt_mutex_detach(&bus->lock);
+        rt_sem_detach(&bus->wake);
+        rt_sem_detach(&bus->done);
+        rt_sem_detach(&bus->round);
+        rt_free(bus);
+        return RT_NULL;
+    }
+    rt_thread_startup(bus->thread);
+
+    return bus;
+}
+
+/* Stop polling after the round in progress, the slaves are left to the application */
+void uart_bus_delete(uart_bus_t bus)
+{
+    if (bus == RT_NULL)
+        return;
+
+    bus->stopping = RT_TRUE;
+    rt_sem_release(&bus->wake);
+    rt_sem_take(&bus->done, RT_WAITING_FOREVER);
+    rt_mutex_detach(&bus->lock);
+    rt_sem_detach(&bus->wake);
+    rt_sem_detach(&bus->done);
+    rt_sem_detach(&bus->round);
+    rt_free(bus);
+}
+
+/*
+ * Poll a slave every poll->period_ms with the request template, the first time
+ * right away. Each poll ends in handler(slave, result, data, size) on the bus
+ * thread; data is resp_buf. slave and resp_buf belong to the bus until
+ * uart_bus_remove().
+ */
+rt_err_t uart_bus_add(uart_bus_t bus, struct uart_bus_slave *slave, const struct uart_bus_poll *poll,
+        rt_uint8_t *resp_buf, rt_size_t resp_buf_size, uart_bus_handler_t handler)
+{
+    if (bus == RT_NULL || slave == RT_NULL || poll == RT_NULL || poll->req_size == 0)
+        return -RT_EINVAL;
+    if (poll->period_ms == 0)
+    {
+        LOG_E("slave %d needs a poll period!", poll->address);
+        return -RT_EINVAL;
+    }
+    if (poll->timeout_ms == 0)
+    {
+        LOG_E("slave %d needs a response timeout!", poll->address);
+        return -RT_EINVAL;
+    }
+    if ((poll->flags & UART_BUS_MATCH_ADDRESS) && resp_buf_size == 0)
+    {
+        LOG_E("slave %d address match needs a response buffer!", poll->address);
+        return -RT_EINVAL;
+    }
+
+    rt_memset(slave, 0x00, sizeof(struct uart_bus_slave));
+    slave->poll = *poll;
+    if (slave->poll.deadline_ms == 0)
+    {
+        slave->poll.deadline_ms = poll->period_ms;
+    }
+    slave->resp_buf = resp_buf;
+    slave->resp_buf_size = resp_buf_size;
+    slave->handler = handler;
+
+    rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    slave->next_due = slave->stat_since = rt_tick_get();
+    rt_list_insert_before(&bus->slaves, &slave->list);
+    rt_mutex_release(&bus->lock);
+    rt_sem_release(&bus->wake);
+
+    return RT_EOK;
+}
+
+static rt_bool_t uart_bus_polling(uart_bus_t bus, struct uart_bus_slave *slave)
+{
+    rt_size_t i;
+
+    for (i = 0; i < bus->polling; i++)
+    {
+        if (bus->batch[i] == slave)
+            return RT_TRUE;
+    }
+    return RT_FALSE;
+}
+
+/* Take a slave out of the table, waiting for a poll of it in progress; its handler is not called for that poll */
+void uart_bus_remove(uart_bus_t bus, struct uart_bus_slave *slave)
+{
+    if (bus == RT_NULL || slave == RT_NULL)
+        return;
+
+    rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    rt_list_remove(&slave->list);
+    rt_list_init(&slave->list);
+    while (uart_bus_polling(bus, slave))
+    {
+        bus->round_waiters++;
+        rt_mutex_release(&bus->lock);
+        rt_sem_take(&bus->round, RT_WAITING_FOREVER);
+        rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    }
+    rt_mutex_release(&bus->lock);
+}
+
+void uart_bus_get_stat(uart_bus_t bus, struct uart_bus_slave *slave, struct uart_bus_stat *stat)
+{
+    rt_tick_t elapsed;
+
+    rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    *stat = slave->stat;
+    stat->srtt = slave->rtt.srtt >> 3;
+    stat->timeout_ms = uart_bus_timeout_ms(slave);
+    elapsed = rt_tick_get() - slave->stat_since;
+    stat->rate_mhz = elapsed ? (rt_uint32_t) ((rt_uint64_t) slave->stat.responses * 1000 * RT_TICK_PER_SECOND
+            / elapsed) : 0;
+    rt_mutex_release(&bus->lock);
+}
+
+void uart_bus_reset_stat(uart_bus_t bus, struct uart_bus_slave *slave)
+{
+    rt_bool_t offline;
+
+    rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    offline = slave->stat.offline;
+    rt_memset(&slave->stat, 0x00, sizeof(slave->stat));
+    slave->stat.offline = offline;
+    slave->stat_since = rt_tick_get();
+    rt_mutex_release(&bus->lock);
+}
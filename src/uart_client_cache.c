@@ -0,0 +1,293 @@
+#include <rtthread.h>
+#include <uart_client_cache.h>
+
+#define DBG_TAG    "uart.cache"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+#define CACHE_LOCK_NAME             "ucca"
+#define CACHE_SEM_NAME              "ucce"
+#define CACHE_ENTRY_MAX             255
+
+/* entry states */
+#define CACHE_EMPTY                 0
+#define CACHE_PENDING               1   /* on the wire, identical requests wait for it */
+#define CACHE_VALID                 2   /* response stored at filled, fresh for callers whose TTL covers its age */
+
+/*
+ * Responses to idempotent requests, kept for a TTL the caller gives per request.
+ * A request whose twin is on the wire waits for that transaction and shares its
+ * response instead of queueing for the wire itself, so a burst of identical
+ * polls costs one round trip whatever the TTL.
+ */
+
+/* FNV-1a, the request bytes are compared as well */
+static rt_uint32_t uart_cache_hash(const rt_uint8_t *req_buf, rt_size_t req_size)
+{
+    rt_uint32_t hash = 2166136261UL;
+
+    while (req_size--)
+    {
+        hash = (hash ^ *req_buf++) * 16777619UL;
+    }
+    return hash;
+}
+
+/* The entry of the request in flight, else the most recently filled one */
+static struct uart_cache_entry *uart_cache_find(uart_cache_t cache, rt_uint32_t key, const rt_uint8_t *req_buf,
+        rt_size_t req_size)
+{
+    struct uart_cache_entry *entry, *found = RT_NULL;
+    rt_size_t i;
+
+    for (i = 0; i < cache->count; i++)
+    {
+        entry = &cache->entries[i];
+        if (entry->state == CACHE_EMPTY || entry->key != key)
+            continue;
+        if (cache->key == RT_NULL
+                && (entry->req_size != req_size || rt_memcmp(entry->req, req_buf, req_size) != 0))
+            continue;
+        if (entry->state == CACHE_PENDING)
+            return entry;
+        if (found == RT_NULL || (rt_int32_t) (entry->filled - found->filled) > 0)
+        {
+            found = entry;
+        }
+    }
+    return found;
+}
+
+/* An entry nobody waits on: empty first, then the one filled longest ago */
+static struct uart_cache_entry *uart_cache_victim(uart_cache_t cache)
+{
+    struct uart_cache_entry *entry, *victim = RT_NULL;
+    rt_size_t i;
+
+    for (i = 0; i < cache->count; i++)
+    {
+        entry = &cache->entries[i];
+        if (entry->state == CACHE_PENDING || entry->waiters > 0)
+            continue;
+        if (entry->state == CACHE_EMPTY)
+            return entry;
+        if (victim == RT_NULL || (rt_int32_t) (entry->filled - victim->filled) < 0)
+        {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+static rt_err_t uart_cache_copy(struct uart_cache_entry *entry, rt_uint8_t *resp_buf, rt_size_t resp_buf_size,
+        rt_size_t *resp_size)
+{
+    rt_size_t size = entry->resp_size < resp_buf_size ? entry->resp_size : resp_buf_size;
+
+    rt_memcpy(resp_buf, entry->resp, size);
+    if (resp_size)
+    {
+        *resp_size = size;
+    }
+    return entry->result;
+}
+
+/*
+ * Create a cache of count entries in front of the client for requests of up to
+ * req_max bytes and responses of up to resp_max bytes. key names the requests
+ * that are answered alike, e.g. ignoring a sequence number; RT_NULL compares the
+ * whole request.
+ */
+uart_cache_t uart_cache_create(uart_client_t client, rt_size_t count, rt_size_t req_max, rt_size_t resp_max,
+        uart_cache_key_t key)
+{
+    struct uart_cache_entry *entry;
+    char name[RT_NAME_MAX];
+    rt_uint8_t *buf;
+    uart_cache_t cache;
+    rt_size_t i;
+
+    if (client == RT_NULL || count == 0 || count > CACHE_ENTRY_MAX || resp_max == 0)
+    {
+        LOG_E("cache needs a client, 1 to %d entries and a response size!", CACHE_ENTRY_MAX);
+        return RT_NULL;
+    }
+
+    /* request copies are kept only to compare bytes */
+    if (key)
+    {
+        req_max = 0;
+    }
+    cache = rt_malloc(sizeof(struct uart_cache) + count * (sizeof(struct uart_cache_entry) + req_max + resp_max));
+    if (cache == RT_NULL)
+    {
+        LOG_E("uart client(%s) no memory for cache!", client->device->parent.name);
+        return RT_NULL;
+    }
+    rt_memset(cache, 0x00, sizeof(struct uart_cache) + count * sizeof(struct uart_cache_entry));
+    cache->client = client;
+    cache->key = key;
+    cache->count = count;
+    cache->req_max = req_max;
+    cache->resp_max = resp_max;
+
+    rt_snprintf(name, RT_NAME_MAX, "%s%d", CACHE_LOCK_NAME, client->index);
+    rt_mutex_init(&cache->lock, name, RT_IPC_FLAG_PRIO);
+    buf = (rt_uint8_t *) &cache->entries[count];
+    for (i = 0; i < count; i++)
+    {
+        entry = &cache->entries[i];
+        rt_snprintf(name, RT_NAME_MAX, "%s%d", CACHE_SEM_NAME, (rt_uint8_t) i);
+        rt_sem_init(&entry->done, name, 0, RT_IPC_FLAG_FIFO);
+        entry->req = buf;
+        entry->resp = buf + req_max;
+        buf += req_max + resp_max;
+    }
+
+    return cache;
+}
+
+/* Nothing may be in flight through the cache */
+void uart_cache_delete(uart_cache_t cache)
+{
+    rt_size_t i;
+
+    if (cache == RT_NULL)
+        return;
+
+    for (i = 0; i < cache->count; i++)
+    {
+        RT_ASSERT(cache->entries[i].state != CACHE_PENDING && cache->entries[i].waiters == 0);
+        rt_sem_detach(&cache->entries[i].done);
+    }
+    rt_mutex_detach(&cache->lock);
+    rt_free(cache);
+}
+
+/*
+ * uart_client_transact() for idempotent requests: a response stored less than
+ * ttl_ms ago is returned without touching the wire, and a request identical to
+ * one in flight shares its response and result, waiting for it at most
+ * timeout_ms. ttl_ms 0 shares in flight responses only. Failed transactions
+ * are not stored.
+ */
+rt_err_t uart_cache_transact(uart_cache_t cache, rt_uint32_t ttl_ms, rt_uint32_t timeout_ms, const rt_uint8_t *req_buf,
+        rt_size_t req_size, rt_uint8_t *resp_buf, rt_size_t resp_buf_size, rt_size_t *resp_size)
+{
+    struct uart_cache_entry *entry;
+    rt_tick_t ttl = rt_tick_from_millisecond(ttl_ms);
+    rt_uint32_t key;
+    rt_err_t result;
+
+    if (cache == RT_NULL)
+        return -RT_EEMPTY;
+
+    key = cache->key ? cache->key(req_buf, req_size) : uart_cache_hash(req_buf, req_size);
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    entry = uart_cache_find(cache, key, req_buf, req_size);
+    if (entry && entry->state == CACHE_VALID && rt_tick_get() - entry->filled < ttl)
+    {
+        cache->stats.hits++;
+        result = uart_cache_copy(entry, resp_buf, resp_buf_size, resp_size);
+        rt_mutex_release(&cache->lock);
+        return result;
+    }
+    if (entry && entry->state == CACHE_PENDING)
+    {
+        /* the twin on the wire wakes every waiter it finds counted here */
+        cache->stats.collapsed++;
+        entry->waiters++;
+        rt_mutex_release(&cache->lock);
+        result = rt_sem_take(&entry->done, rt_tick_from_millisecond(timeout_ms));
+        rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+        if (result != RT_EOK && entry->state == CACHE_PENDING)
+        {
+            /* no longer counted, the twin will not wake us */
+            entry->waiters--;
+            rt_mutex_release(&cache->lock);
+            return -RT_ETIMEOUT;
+        }
+        if (result != RT_EOK)
+        {
+            /* woken while timing out, take the wakeup meant for us */
+            rt_sem_take(&entry->done, RT_WAITING_FOREVER);
+        }
+        result = uart_cache_copy(entry, resp_buf, resp_buf_size, resp_size);
+        entry->waiters--;
+        rt_mutex_release(&cache->lock);
+        return result;
+    }
+
+    /* a response too old for this caller is refreshed in place unless still being copied */
+    if (entry == RT_NULL || entry->waiters > 0)
+    {
+        entry = req_size <= cache->req_max || cache->key ? uart_cache_victim(cache) : RT_NULL;
+    }
+    if (entry == RT_NULL)
+    {
+        cache->stats.bypassed++;
+        rt_mutex_release(&cache->lock);
+        return uart_client_transact(cache->client, timeout_ms, req_buf, req_size, resp_buf, resp_buf_size,
+                resp_size);
+    }
+    cache->stats.misses++;
+    entry->state = CACHE_PENDING;
+    entry->key = key;
+    entry->req_size = req_size;
+    if (cache->key == RT_NULL)
+    {
+        rt_memcpy(entry->req, req_buf, req_size);
+    }
+    rt_mutex_release(&cache->lock);
+
+    result = uart_client_transact(cache->client, timeout_ms, req_buf, req_size, entry->resp, cache->resp_max,
+            &entry->resp_size);
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    entry->result = result;
+    entry->filled = rt_tick_get();
+    entry->state = (result == RT_EOK) ? CACHE_VALID : CACHE_EMPTY;
+    /* waiters copy under the lock, an entry they still read is never reused */
+    for (rt_uint16_t i = 0; i < entry->waiters; i++)
+    {
+        rt_sem_release(&entry->done);
+    }
+    uart_cache_copy(entry, resp_buf, resp_buf_size, resp_size);
+    rt_mutex_release(&cache->lock);
+
+    return result;
+}
+
+/* Forget every stored response, e.g. after a write that changes what the slave returns */
+void uart_cache_invalidate(uart_cache_t cache)
+{
+    rt_size_t i;
+
+    if (cache == RT_NULL)
+        return;
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    for (i = 0; i < cache->count; i++)
+    {
+        if (cache->entries[i].state == CACHE_VALID)
+        {
+            cache->entries[i].state = CACHE_EMPTY;
+        }
+    }
+    rt_mutex_release(&cache->lock);
+}
+
+void uart_cache_get_stats(uart_cache_t cache, struct uart_cache_stats *stats)
+{
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    *stats = cache->stats;
+    rt_mutex_release(&cache->lock);
+}
+
+void uart_cache_reset_stats(uart_cache_t cache)
+{
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    rt_memset(&cache->stats, 0x00, sizeof(cache->stats));
+    rt_mutex_release(&cache->lock);
+}
@@ -0,0 +1,752 @@
+#include <rtthread.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include <uart_client_capture.h>
+#ifdef RT_USING_DFS
+#include <dfs_posix.h>
+#endif
+
+#define DBG_TAG    "uart.capture"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+#define CAPTURE_THREAD_NAME         "uccap"
+#define CAPTURE_WAKE_NAME           "uccapw"
+#define CAPTURE_DONE_NAME           "uccapd"
+
+/* type byte of a record in the ring: raised once the record is complete */
+#define CAPTURE_COMMITTED           0x80
+#define CAPTURE_TYPE_OFFSET         6
+
+#define CAPTURE_MIN_SIZE            64
+
+/*
+ * Records go into a power of two byte ring addressed by free running positions.
+ * A writer reserves its record with interrupts disabled for a few instructions,
+ * copies the data with them enabled and raises the committed bit of the type
+ * byte last. The drain stops at the first record not yet committed, so writers
+ * on different threads never wait for each other or for the drain.
+ */
+struct uart_capture
+{
+    rt_uint8_t *ring;               /* RT_NULL: not capturing */
+    rt_uint32_t mask;
+    volatile rt_uint32_t head;      /* reserved up to here */
+    volatile rt_uint32_t tail;      /* drained up to here */
+    volatile rt_uint16_t writers;   /* reservations not yet committed */
+    volatile rt_bool_t stopping;
+    rt_bool_t header_pending;
+    rt_uint32_t lost_reported;
+    struct uart_capture_stat stat;
+    uart_capture_sink_t sink;       /* RT_NULL: drained by uart_capture_read() */
+    void *ctx;
+    struct rt_semaphore wake;
+    struct rt_semaphore done;
+#ifdef RT_USING_DFS
+    int fd;
+#endif
+};
+
+static struct uart_capture uart_capture;
+
+static rt_uint32_t uart_capture_tick_clock(void)
+{
+    return (rt_uint32_t) ((rt_uint64_t) rt_tick_get() * 1000000 / RT_TICK_PER_SECOND);
+}
+
+static rt_uint32_t (*uart_capture_clock)(void) = uart_capture_tick_clock;
+
+/* Timestamps come from clock_us, called with interrupts disabled; RT_NULL restores the tick clock */
+void uart_capture_set_clock(rt_uint32_t (*clock_us)(void))
+{
+    uart_capture_clock = clock_us ? clock_us : uart_capture_tick_clock;
+}
+
+static void uart_capture_copy_in(rt_uint32_t pos, const void *data, rt_size_t len)
+{
+    rt_uint32_t off = pos & uart_capture.mask;
+    rt_size_t first = uart_capture.mask + 1 - off;
+
+    if (first > len)
+        first = len;
+    rt_memcpy(&uart_capture.ring[off], data, first);
+    rt_memcpy(uart_capture.ring, (const rt_uint8_t *) data + first, len - first);
+}
+
+static void uart_capture_copy_out(rt_uint32_t pos, void *data, rt_size_t len)
+{
+    rt_uint32_t off = pos & uart_capture.mask;
+    rt_size_t first = uart_capture.mask + 1 - off;
+
+    if (first > len)
+        first = len;
+    rt_memcpy(data, &uart_capture.ring[off], first);
+    rt_memcpy((rt_uint8_t *) data + first, uart_capture.ring, len - first);
+}
+
+/* Reserve a record of len data bytes, RT_FALSE when not capturing or the ring is full */
+rt_bool_t uart_capture_begin(uart_client_t client, enum uart_capture_type type, rt_size_t len,
+        struct uart_capture_slot *slot)
+{
+    struct uart_capture_record rec;
+    rt_uint32_t used, need = sizeof(rec) + len;
+    rt_bool_t wake = RT_FALSE;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (uart_capture.ring == RT_NULL || uart_capture.stopping)
+    {
+        rt_hw_interrupt_enable(level);
+        return RT_FALSE;
+    }
+    used = uart_capture.head - uart_capture.tail;
+    if (len > 0xFFFF || need > uart_capture.mask + 1 - used)
+    {
+        uart_capture.stat.dropped++;
+        rt_hw_interrupt_enable(level);
+        return RT_FALSE;
+    }
+    slot->start = uart_capture.head;
+    uart_capture.head += need;
+    uart_capture.writers++;
+    /* not committed until uart_capture_commit() */
+    uart_capture.ring[(slot->start + CAPTURE_TYPE_OFFSET) & uart_capture.mask] = type;
+    rec.time_us = uart_capture_clock();
+    uart_capture.stat.records++;
+    uart_capture.stat.bytes += len;
+    if (used + need > uart_capture.stat.used_max)
+    {
+        uart_capture.stat.used_max = used + need;
+    }
+    /* wake the writer once per crossing of the half mark */
+    wake = uart_capture.sink && used <= uart_capture.mask / 2 && used + need > uart_capture.mask / 2;
+    rt_hw_interrupt_enable(level);
+
+    rec.len = len;
+    rec.type = type;
+    rec.channel = (rt_uint8_t) client->index;
+    uart_capture_copy_in(slot->start, &rec, sizeof(rec));
+    slot->pos = slot->start + sizeof(rec);
+    if (wake)
+    {
+        rt_sem_release(&uart_capture.wake);
+    }
+    return RT_TRUE;
+}
+
+void uart_capture_append(struct uart_capture_slot *slot, const void *data, rt_size_t len)
+{
+    uart_capture_copy_in(slot->pos, data, len);
+    slot->pos += len;
+}
+
+void uart_capture_commit(struct uart_capture_slot *slot)
+{
+    rt_base_t level;
+
+    /* the critical section orders the data before the committed bit */
+    level = rt_hw_interrupt_disable();
+    uart_capture.ring[(slot->start + CAPTURE_TYPE_OFFSET) & uart_capture.mask] |= CAPTURE_COMMITTED;
+    uart_capture.writers--;
+    rt_hw_interrupt_enable(level);
+}
+
+/* Bytes of complete records at the tail, at most limit, with their committed bits taken off */
+static rt_uint32_t uart_capture_ready(rt_size_t limit)
+{
+    volatile rt_uint8_t *type;
+    struct uart_capture_record rec;
+    rt_uint32_t pos = uart_capture.tail;
+    rt_uint32_t head = uart_capture.head;
+
+    while (pos != head)
+    {
+        type = &uart_capture.ring[(pos + CAPTURE_TYPE_OFFSET) & uart_capture.mask];
+        if (!(*type & CAPTURE_COMMITTED))
+            break;
+        uart_capture_copy_out(pos, &rec, sizeof(rec));
+        if (pos + sizeof(rec) + rec.len - uart_capture.tail > limit)
+            break;
+        *type &= ~CAPTURE_COMMITTED;
+        pos += sizeof(rec) + rec.len;
+    }
+    return pos - uart_capture.tail;
+}
+
+/* The record reporting drops since the previous one, 0 when there were none */
+static rt_size_t uart_capture_lost(rt_uint8_t *buf)
+{
+    struct uart_capture_record rec;
+    rt_uint32_t dropped = uart_capture.stat.dropped - uart_capture.lost_reported;
+
+    if (dropped == 0)
+        return 0;
+    uart_capture.lost_reported += dropped;
+    rec.time_us = uart_capture_clock();
+    rec.len = sizeof(dropped);
+    rec.type = UART_CAPTURE_LOST;
+    rec.channel = 0;
+    rt_memcpy(buf, &rec, sizeof(rec));
+    rt_memcpy(buf + sizeof(rec), &dropped, sizeof(dropped));
+    return sizeof(rec) + sizeof(dropped);
+}
+
+static void uart_capture_header(struct uart_capture_header *header)
+{
+    rt_memcpy(header->magic, UART_CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = UART_CAPTURE_VERSION;
+    header->header_size = sizeof(*header);
+    header->record_size = sizeof(struct uart_capture_record);
+    header->reserved = 0;
+}
+
+/* Hand everything complete to the sink, straight from the ring */
+static rt_bool_t uart_capture_flush(void)
+{
+    rt_uint8_t lost[sizeof(struct uart_capture_record) + sizeof(rt_uint32_t)];
+    struct uart_capture_header header;
+    rt_uint32_t len, off, first;
+    rt_size_t size;
+
+    if (uart_capture.header_pending)
+    {
+        uart_capture_header(&header);
+        if (uart_capture.sink(uart_capture.ctx, &header, sizeof(header)) < sizeof(header))
+            return RT_FALSE;
+        uart_capture.header_pending = RT_FALSE;
+    }
+
+    while ((len = uart_capture_ready(uart_capture.mask + 1)) > 0)
+    {
+        off = uart_capture.tail & uart_capture.mask;
+        first = uart_capture.mask + 1 - off;
+        if (first > len)
+            first = len;
+        if (uart_capture.sink(uart_capture.ctx, &uart_capture.ring[off], first) < first)
+            return RT_FALSE;
+        if (first < len && uart_capture.sink(uart_capture.ctx, uart_capture.ring, len - first) < len - first)
+            return RT_FALSE;
+        uart_capture.tail += len;
+    }
+
+    size = uart_capture_lost(lost);
+    if (size > 0 && uart_capture.sink(uart_capture.ctx, lost, size) < size)
+        return RT_FALSE;
+    return RT_TRUE;
+}
+
+static void uart_capture_entry(void *parameter)
+{
+    rt_bool_t failed = RT_FALSE;
+
+    while (!uart_capture.stopping)
+    {
+        rt_sem_take(&uart_capture.wake, rt_tick_from_millisecond(PKG_UART_CLIENT_CAPTURE_FLUSH_MS));
+        if (!failed && !uart_capture.stopping && !uart_capture_flush())
+        {
+            LOG_E("capture sink failed, capture stopped!");
+            uart_capture.stopping = RT_TRUE;
+            failed = RT_TRUE;
+        }
+    }
+
+    /* what the writers left behind once uart_capture_stop() saw them finish */
+    while (uart_capture.writers > 0)
+    {
+        rt_sem_take(&uart_capture.wake, RT_WAITING_FOREVER);
+    }
+    if (!failed)
+    {
+        uart_capture_flush();
+    }
+    rt_sem_release(&uart_capture.done);
+}
+
+/*
+ * Start recording the clients attached with uart_capture_attach() into a ring of
+ * ring_size bytes, rounded down to a power of two. With a sink a background thread
+ * streams the capture to it, otherwise the application drains it with
+ * uart_capture_read(). Records that do not fit are counted and reported in the
+ * stream as UART_CAPTURE_LOST.
+ */
+rt_err_t uart_capture_start(rt_size_t ring_size, uart_capture_sink_t sink, void *ctx)
+{
+    rt_thread_t thread;
+    rt_uint8_t *ring;
+    rt_uint32_t size = CAPTURE_MIN_SIZE;
+
+    if (uart_capture.ring != RT_NULL)
+    {
+        LOG_E("capture is already running!");
+        return -RT_EBUSY;
+    }
+    if (ring_size < CAPTURE_MIN_SIZE)
+    {
+        LOG_E("capture ring must hold at least %d bytes!", CAPTURE_MIN_SIZE);
+        return -RT_EINVAL;
+    }
+    while (size <= ring_size / 2)
+    {
+        size <<= 1;
+    }
+
+    ring = rt_malloc(size);
+    if (ring == RT_NULL)
+    {
+        LOG_E("no memory for the capture ring!");
+        return -RT_ENOMEM;
+    }
+
+    rt_memset(&uart_capture.stat, 0x00, sizeof(uart_capture.stat));
+    uart_capture.stat.size = size;
+    uart_capture.mask = size - 1;
+    uart_capture.head = uart_capture.tail = 0;
+    uart_capture.writers = 0;
+    uart_capture.stopping = RT_FALSE;
+    uart_capture.header_pending = RT_TRUE;
+    uart_capture.lost_reported = 0;
+    uart_capture.sink = sink;
+    uart_capture.ctx = ctx;
+#ifdef RT_USING_DFS
+    uart_capture.fd = -1;
+#endif
+    if (sink)
+    {
+        rt_sem_init(&uart_capture.wake, CAPTURE_WAKE_NAME, 0, RT_IPC_FLAG_FIFO);
+        rt_sem_init(&uart_capture.done, CAPTURE_DONE_NAME, 0, RT_IPC_FLAG_FIFO);
+        thread = rt_thread_create(CAPTURE_THREAD_NAME, uart_capture_entry, RT_NULL,
+                PKG_UART_CLIENT_THREAD_STACK_SIZE, PKG_UART_CLIENT_CAPTURE_PRIORITY, 10);
+        if (thread == RT_NULL)
+        {
+            LOG_E("create capture thread failed!");
+            rt_sem_detach(&uart_capture.wake);
+            rt_sem_detach(&uart_capture.done);
+            rt_free(ring);
+            return -RT_ENOMEM;
+        }
+        rt_thread_startup(thread);
+    }
+    /* published last, writers start recording from here */
+    uart_capture.ring = ring;
+    return RT_EOK;
+}
+
+/* Stop recording; the sink gets the remaining records, unread ones are dropped in read mode */
+void uart_capture_stop(void)
+{
+    rt_uint8_t *ring;
+    rt_base_t level;
+
+    if (uart_capture.ring == RT_NULL)
+        return;
+
+    level = rt_hw_interrupt_disable();
+    uart_capture.stopping = RT_TRUE;
+    rt_hw_interrupt_enable(level);
+    if (uart_capture.sink)
+    {
+        rt_sem_release(&uart_capture.wake);
+        while (uart_capture.writers > 0)
+        {
+            rt_thread_delay(1);
+            rt_sem_release(&uart_capture.wake);
+        }
+        rt_sem_take(&uart_capture.done, RT_WAITING_FOREVER);
+        rt_sem_detach(&uart_capture.wake);
+        rt_sem_detach(&uart_capture.done);
+    }
+    else
+    {
+        while (uart_capture.writers > 0)
+        {
+            rt_thread_delay(1);
+        }
+    }
+#ifdef RT_USING_DFS
+    if (uart_capture.fd >= 0)
+    {
+        close(uart_capture.fd);
+        uart_capture.fd = -1;
+    }
+#endif
+
+    level = rt_hw_interrupt_disable();
+    ring = uart_capture.ring;
+    uart_capture.ring = RT_NULL;
+    rt_hw_interrupt_enable(level);
+    rt_free(ring);
+}
+
+/* Record the traffic of a client while a capture runs, its index is the channel */
+void uart_capture_attach(uart_client_t client, rt_bool_t enable)
+{
+    if (client == RT_NULL)
+        return;
+
+    client->capture = enable;
+}
+
+/* Drain whole records into buf when capturing without a sink, returns the bytes copied */
+rt_size_t uart_capture_read(void *buf, rt_size_t size)
+{
+    rt_uint8_t *out = buf;
+    rt_size_t off = 0;
+    rt_uint32_t len;
+
+    if (uart_capture.ring == RT_NULL || uart_capture.sink)
+        return 0;
+
+    if (uart_capture.header_pending)
+    {
+        if (size < sizeof(struct uart_capture_header))
+            return 0;
+        uart_capture_header((struct uart_capture_header *) out);
+        uart_capture.header_pending = RT_FALSE;
+        off = sizeof(struct uart_capture_header);
+    }
+    len = uart_capture_ready(size - off);
+    uart_capture_copy_out(uart_capture.tail, &out[off], len);
+    uart_capture.tail += len;
+    off += len;
+    if (size - off >= sizeof(struct uart_capture_record) + sizeof(rt_uint32_t))
+    {
+        off += uart_capture_lost(&out[off]);
+    }
+    return off;
+}
+
+void uart_capture_get_stat(struct uart_capture_stat *stat)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    *stat = uart_capture.stat;
+    stat->used = uart_capture.head - uart_capture.tail;
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef RT_USING_DFS
+static rt_size_t uart_capture_file_write(void *ctx, const void *buf, rt_size_t size)
+{
+    int len = write((int) (rt_ubase_t) ctx, buf, size);
+    return len < 0 ? 0 : len;
+}
+
+/* Stream the capture into a file, closed by uart_capture_stop() */
+rt_err_t uart_capture_start_file(const char *path, rt_size_t ring_size)
+{
+    rt_err_t result;
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    if (fd < 0)
+    {
+        LOG_E("open %s failed!", path);
+        return -RT_EIO;
+    }
+    result = uart_capture_start(ring_size, uart_capture_file_write, (void *) (rt_ubase_t) fd);
+    if (result != RT_EOK)
+    {
+        close(fd);
+        return result;
+    }
+    uart_capture.fd = fd;
+    return RT_EOK;
+}
+#endif
+
+/*
+ * Replay: a memory backed character device plays the UART driver. A client
+ * opened on it with the framing of the captured one gets the recorded RX
+ * bytes in the chunks the driver returned them, writes are discarded.
+ */
+struct uart_replay_device
+{
+    struct rt_device parent;
+    rt_uint8_t *ring;
+    rt_size_t ring_size;
+    volatile rt_size_t head;
+    volatile rt_size_t tail;
+};
+
+static rt_err_t uart_replay_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    /* no DMA, the client falls back to interrupt mode */
+    return (oflag & RT_DEVICE_FLAG_DMA_RX) ? -RT_EIO : RT_EOK;
+}
+
+static rt_size_t uart_replay_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct uart_replay_device *rdev = (struct uart_replay_device *) dev;
+    rt_uint8_t *out = buffer;
+    rt_size_t len = 0;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    while (len < size && rdev->tail != rdev->head)
+    {
+        out[len++] = rdev->ring[rdev->tail];
+        rdev->tail = (rdev->tail + 1) % rdev->ring_size;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return len;
+}
+
+static rt_size_t uart_replay_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return size;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+static const struct rt_device_ops uart_replay_ops =
+{
+    RT_NULL,
+    uart_replay_open,
+    RT_NULL,
+    uart_replay_read,
+    uart_replay_write,
+    RT_NULL
+};
+#endif
+
+rt_err_t uart_replay_device_register(const char *name, rt_size_t ring_size)
+{
+    struct uart_replay_device *rdev;
+    rt_err_t result;
+
+    if (rt_device_find(name) != RT_NULL)
+    {
+        LOG_E("device %s already exists!", name);
+        return -RT_EBUSY;
+    }
+    rdev = rt_calloc(1, sizeof(struct uart_replay_device) + ring_size);
+    if (rdev == RT_NULL)
+        return -RT_ENOMEM;
+    rdev->ring = (rt_uint8_t *) (rdev + 1);
+    rdev->ring_size = ring_size;
+
+    rdev->parent.type = RT_Device_Class_Char;
+#ifdef RT_USING_DEVICE_OPS
+    rdev->parent.ops = &uart_replay_ops;
+#else
+    rdev->parent.open = uart_replay_open;
+    rdev->parent.read = uart_replay_read;
+    rdev->parent.write = uart_replay_write;
+#endif
+    result = rt_device_register(&rdev->parent, name, RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
+    if (result != RT_EOK)
+    {
+        rt_free(rdev);
+    }
+    return result;
+}
+
+/* Push one chunk with a single rx_indicate, as an idle line interrupt would, waiting for room */
+static void uart_replay_push(struct uart_replay_device *rdev, const rt_uint8_t *data, rt_size_t len)
+{
+    rt_size_t count;
+    rt_base_t level;
+
+    while (len > 0)
+    {
+        level = rt_hw_interrupt_disable();
+        while (len > 0 && (rdev->head + 1) % rdev->ring_size != rdev->tail)
+        {
+            rdev->ring[rdev->head] = *data++;
+            rdev->head = (rdev->head + 1) % rdev->ring_size;
+            len--;
+        }
+        count = (rdev->head + rdev->ring_size - rdev->tail) % rdev->ring_size;
+        if (rdev->parent.rx_indicate && count > 0)
+        {
+            rdev->parent.rx_indicate(&rdev->parent, count);
+        }
+        rt_hw_interrupt_enable(level);
+        if (len > 0)
+        {
+            rt_thread_delay(1);
+        }
+    }
+}
+
+/* Sleep until offset_us after start_us on the capture clock */
+static void uart_replay_pace(rt_uint32_t start_us, rt_uint32_t offset_us)
+{
+    const rt_int32_t tick_us = 1000000 / RT_TICK_PER_SECOND;
+    rt_int32_t wait;
+
+    while ((wait = (rt_int32_t) (offset_us - (uart_capture_clock() - start_us))) > 0)
+    {
+        if (wait < tick_us)
+        {
+            rt_hw_us_delay(wait);
+            break;
+        }
+        rt_thread_delay(wait / tick_us);
+    }
+}
+
+/*
+ * Silence in us that ends a frame for the client on the replay device, 0 without
+ * one. The device has no baud rate, character timed gaps use the fixed Modbus one.
+ */
+static rt_uint32_t uart_replay_silence_us(struct uart_replay_device *rdev)
+{
+    uart_client_t client = uart_client_get_by_device(&rdev->parent);
+
+    if (client == RT_NULL)
+        return 0;
+    if (client->frame_cfg.mode == UART_FRAME_MODBUS_RTU || client->frame_timeout_ms == UART_CLIENT_FRAME_TIMEOUT_AUTO)
+        return 1750;
+    return client->frame_timeout_ms * 1000;
+}
+
+/* Let the client read everything pushed, then keep the line quiet for silence_us */
+static void uart_replay_gap(struct uart_replay_device *rdev, rt_uint32_t silence_us)
+{
+    while (rdev->tail != rdev->head)
+    {
+        rt_thread_delay(1);
+    }
+    /* one extra tick as the client rounds its own wait up */
+    rt_thread_delay(rt_tick_from_millisecond((silence_us + 999) / 1000) + 1);
+}
+
+/*
+ * Feed the RX records of channel, or of every channel when it is negative, into
+ * the replay device dev_name. Returns once the last record is pushed; the client
+ * on the device may still be working through it. At full speed a recorded gap
+ * long enough to end a frame is shortened to just that, shorter ones are dropped.
+ */
+rt_err_t uart_replay(const char *dev_name, const void *capture, rt_size_t size, int channel,
+        enum uart_replay_speed speed)
+{
+    struct uart_replay_device *rdev;
+    struct uart_capture_header header;
+    struct uart_capture_record rec;
+    const rt_uint8_t *p = capture, *end = p + size;
+    rt_uint32_t start_us = 0, first_us = 0, last_us = 0, silence_us;
+    rt_bool_t first = RT_TRUE;
+    rt_device_t dev;
+
+    dev = rt_device_find(dev_name);
+#ifdef RT_USING_DEVICE_OPS
+    if (dev == RT_NULL || dev->ops != &uart_replay_ops)
+#else
+    if (dev == RT_NULL || dev->read != uart_replay_read)
+#endif
+    {
+        LOG_E("%s is not a replay device!", dev_name);
+        return -RT_EINVAL;
+    }
+    rdev = (struct uart_replay_device *) dev;
+    silence_us = uart_replay_silence_us(rdev);
+
+    if (size >= sizeof(header) && rt_memcmp(p, UART_CAPTURE_MAGIC, sizeof(header.magic)) == 0)
+    {
+        rt_memcpy(&header, p, sizeof(header));
+        if (header.version != UART_CAPTURE_VERSION || header.record_size != sizeof(rec))
+        {
+            LOG_E("unsupported capture version %d!", header.version);
+            return -RT_ERROR;
+        }
+        p += header.header_size;
+    }
+
+    while (p < end)
+    {
+        if ((rt_size_t) (end - p) < sizeof(rec))
+            break;
+        rt_memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if (rec.len > (rt_size_t) (end - p))
+            break;
+
+        if (rec.type == UART_CAPTURE_RX && (channel < 0 || rec.channel == channel))
+        {
+            if (speed == UART_REPLAY_REALTIME)
+            {
+                if (first)
+                {
+                    first_us = rec.time_us;
+                    start_us = uart_capture_clock();
+                    first = RT_FALSE;
+                }
+                uart_replay_pace(start_us, rec.time_us - first_us);
+            }
+            else if (!first && silence_us > 0 && rec.time_us - last_us >= silence_us)
+            {
+                uart_replay_gap(rdev, silence_us);
+            }
+            first = RT_FALSE;
+            last_us = rec.time_us;
+            uart_replay_push(rdev, p, rec.len);
+        }
+        p += rec.len;
+    }
+    if (p < end)
+    {
+        LOG_E("capture truncated at byte %d!", (int) (p - (const rt_uint8_t *) capture));
+        return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_FINSH
+#include <stdlib.h>
+
+static void uart_capture_usage(void)
+{
+    rt_kprintf("Usage:\n");
+#ifdef RT_USING_DFS
+    rt_kprintf("uart_capture start <file> [ring size]\n");
+#endif
+    rt_kprintf("uart_capture attach <device> [0|1]\n");
+    rt_kprintf("uart_capture stop\n");
+    rt_kprintf("uart_capture stat\n");
+}
+
+static void uart_capture_cmd(int argc, char **argv)
+{
+    struct uart_capture_stat stat;
+    uart_client_t client;
+
+    if (argc < 2)
+    {
+        uart_capture_usage();
+    }
+#ifdef RT_USING_DFS
+    else if (!rt_strcmp(argv[1], "start") && argc > 2)
+    {
+        uart_capture_start_file(argv[2], argc > 3 ? atoi(argv[3]) : 4096);
+    }
+#endif
+    else if (!rt_strcmp(argv[1], "attach") && argc > 2)
+    {
+        client = uart_client_get_by_name(argv[2]);
+        if (client == RT_NULL)
+        {
+            rt_kprintf("no uart client on %s\n", argv[2]);
+            return;
+        }
+        uart_capture_attach(client, argc > 3 ? atoi(argv[3]) : RT_TRUE);
+    }
+    else if (!rt_strcmp(argv[1], "stop"))
+    {
+        uart_capture_stop();
+    }
+    else if (!rt_strcmp(argv[1], "stat"))
+    {
+        uart_capture_get_stat(&stat);
+        rt_kprintf("records %d, bytes %d, dropped %d, ring %d/%d used, max %d\n", stat.records, stat.bytes,
+                stat.dropped, stat.used, stat.size, stat.used_max);
+    }
+    else
+    {
+        uart_capture_usage();
+    }
+}
+MSH_CMD_EXPORT_ALIAS(uart_capture_cmd, uart_capture, uart client traffic capture);
+#endif
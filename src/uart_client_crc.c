@@ -0,0 +1,339 @@
+#include <rtthread.h>
+#include <rthw.h>
+#include <uart_client_crc.h>
+
+#define DBG_TAG    "uart.crc"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+#if PKG_UART_CLIENT_CRC_SLICES != 1 && PKG_UART_CLIENT_CRC_SLICES != 4 && PKG_UART_CLIENT_CRC_SLICES != 8
+#error "PKG_UART_CLIENT_CRC_SLICES must be 1, 4 or 8"
+#endif
+
+/*
+ * Table k holds the CRC of a byte followed by k zero bytes, so slice-by-N folds
+ * N input bytes with N independent lookups. Tables are built on the heap the
+ * first time an engine is asked for; until then, or without memory, the engine
+ * runs the bit loop.
+ */
+struct uart_crc_engine
+{
+    struct uart_tx_crc crc;
+    rt_uint32_t poly;               /* reflected for reflected engines, 0 for checksums */
+    rt_bool_t reflected;
+    rt_bool_t hw;                   /* update replaced by uart_crc_set_update() */
+    rt_uint32_t *table;
+    uart_crc_update_t kernels[UART_CRC_KERNEL_NUM];
+};
+
+static struct uart_crc_engine uart_crc_engines[UART_CRC_TYPE_NUM];
+
+#define CRC_T(table, k, i)          ((table)[(k) * 256 + (i)])
+
+static rt_uint32_t crc_reflected_bits(rt_uint32_t poly, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    int bit;
+
+    while (size--)
+    {
+        crc ^= *data++;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static rt_uint32_t crc_reflected_slice1(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    while (size--)
+    {
+        crc = (crc >> 8) ^ CRC_T(t, 0, (crc ^ *data++) & 0xFF);
+    }
+    return crc;
+}
+
+static rt_uint32_t crc_reflected_slice4(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    for (; size >= 4; size -= 4, data += 4)
+    {
+        crc ^= data[0] | (data[1] << 8) | ((rt_uint32_t) data[2] << 16) | ((rt_uint32_t) data[3] << 24);
+        crc = CRC_T(t, 3, crc & 0xFF) ^ CRC_T(t, 2, (crc >> 8) & 0xFF) ^ CRC_T(t, 1, (crc >> 16) & 0xFF)
+                ^ CRC_T(t, 0, crc >> 24);
+    }
+    return crc_reflected_slice1(t, crc, data, size);
+}
+
+static rt_uint32_t crc_reflected_slice8(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        crc ^= data[0] | (data[1] << 8) | ((rt_uint32_t) data[2] << 16) | ((rt_uint32_t) data[3] << 24);
+        crc = CRC_T(t, 7, crc & 0xFF) ^ CRC_T(t, 6, (crc >> 8) & 0xFF) ^ CRC_T(t, 5, (crc >> 16) & 0xFF)
+                ^ CRC_T(t, 4, crc >> 24) ^ CRC_T(t, 3, data[4]) ^ CRC_T(t, 2, data[5]) ^ CRC_T(t, 1, data[6])
+                ^ CRC_T(t, 0, data[7]);
+    }
+    return crc_reflected_slice1(t, crc, data, size);
+}
+
+/* most significant bit first, 16 bits wide */
+static rt_uint32_t crc_normal_bits(rt_uint32_t poly, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    int bit;
+
+    while (size--)
+    {
+        crc ^= (rt_uint32_t) *data++ << 8;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ poly : crc << 1;
+        }
+        crc &= 0xFFFF;
+    }
+    return crc;
+}
+
+static rt_uint32_t crc_normal_slice1(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    while (size--)
+    {
+        crc = ((crc << 8) & 0xFFFF) ^ CRC_T(t, 0, ((crc >> 8) ^ *data++) & 0xFF);
+    }
+    return crc;
+}
+
+static rt_uint32_t crc_normal_slice4(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    for (; size >= 4; size -= 4, data += 4)
+    {
+        crc ^= (data[0] << 8) | data[1];
+        crc = CRC_T(t, 3, crc >> 8) ^ CRC_T(t, 2, crc & 0xFF) ^ CRC_T(t, 1, data[2]) ^ CRC_T(t, 0, data[3]);
+    }
+    return crc_normal_slice1(t, crc, data, size);
+}
+
+static rt_uint32_t crc_normal_slice8(const rt_uint32_t *t, rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size)
+{
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        crc ^= (data[0] << 8) | data[1];
+        crc = CRC_T(t, 7, crc >> 8) ^ CRC_T(t, 6, crc & 0xFF) ^ CRC_T(t, 5, data[2]) ^ CRC_T(t, 4, data[3])
+                ^ CRC_T(t, 3, data[4]) ^ CRC_T(t, 2, data[5]) ^ CRC_T(t, 1, data[6]) ^ CRC_T(t, 0, data[7]);
+    }
+    return crc_normal_slice1(t, crc, data, size);
+}
+
+static rt_uint32_t checksum_sum8(rt_uint32_t sum, const rt_uint8_t *data, rt_size_t size)
+{
+    while (size--)
+    {
+        sum += *data++;
+    }
+    return sum & 0xFF;
+}
+
+static rt_uint32_t checksum_xor8(rt_uint32_t sum, const rt_uint8_t *data, rt_size_t size)
+{
+    while (size--)
+    {
+        sum ^= *data++;
+    }
+    return sum;
+}
+
+/* update functions carry no context, so every engine gets its own set of kernel wrappers */
+#define UART_CRC_KERNELS(name, type, kind) \
+    static rt_uint32_t name##_bits(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size) \
+    { \
+        return crc_##kind##_bits(uart_crc_engines[type].poly, crc, data, size); \
+    } \
+    static rt_uint32_t name##_slice1(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size) \
+    { \
+        return crc_##kind##_slice1(uart_crc_engines[type].table, crc, data, size); \
+    } \
+    static rt_uint32_t name##_slice4(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size) \
+    { \
+        return crc_##kind##_slice4(uart_crc_engines[type].table, crc, data, size); \
+    } \
+    static rt_uint32_t name##_slice8(rt_uint32_t crc, const rt_uint8_t *data, rt_size_t size) \
+    { \
+        return crc_##kind##_slice8(uart_crc_engines[type].table, crc, data, size); \
+    }
+
+UART_CRC_KERNELS(crc16_modbus, UART_CRC16_MODBUS, reflected)
+UART_CRC_KERNELS(crc16_ccitt, UART_CRC16_CCITT, normal)
+UART_CRC_KERNELS(crc32, UART_CRC32, reflected)
+
+#define UART_CRC_ENGINE(name, init, xor_out, size, big_endian, poly, reflected) \
+    { { init, xor_out, name##_bits, size, big_endian }, poly, reflected, RT_FALSE, RT_NULL, \
+      { name##_bits, name##_slice1, name##_slice4, name##_slice8 } }
+
+static struct uart_crc_engine uart_crc_engines[UART_CRC_TYPE_NUM] =
+{
+    UART_CRC_ENGINE(crc16_modbus, 0xFFFF, 0x0000, 2, 0, 0xA001, RT_TRUE),
+    UART_CRC_ENGINE(crc16_ccitt, 0xFFFF, 0x0000, 2, 1, 0x1021, RT_FALSE),
+    UART_CRC_ENGINE(crc32, 0xFFFFFFFF, 0xFFFFFFFF, 4, 0, 0xEDB88320, RT_TRUE),
+    { { 0, 0, checksum_sum8, 1, 0 }, 0, RT_FALSE, RT_FALSE, RT_NULL, { checksum_sum8 } },
+    { { 0, 0, checksum_xor8, 1, 0 }, 0, RT_FALSE, RT_FALSE, RT_NULL, { checksum_xor8 } },
+};
+
+static void uart_crc_table_build(const struct uart_crc_engine *engine, rt_uint32_t *table)
+{
+    rt_uint8_t byte;
+    rt_uint32_t prev;
+    int i, k;
+
+    for (i = 0; i < 256; i++)
+    {
+        byte = (rt_uint8_t) i;
+        if (engine->reflected)
+        {
+            CRC_T(table, 0, i) = crc_reflected_bits(engine->poly, 0, &byte, 1);
+        }
+        else
+        {
+            CRC_T(table, 0, i) = crc_normal_bits(engine->poly, 0, &byte, 1);
+        }
+    }
+    for (k = 1; k < PKG_UART_CLIENT_CRC_SLICES; k++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            prev = CRC_T(table, k - 1, i);
+            if (engine->reflected)
+            {
+                CRC_T(table, k, i) = (prev >> 8) ^ CRC_T(table, 0, prev & 0xFF);
+            }
+            else
+            {
+                CRC_T(table, k, i) = ((prev << 8) & 0xFFFF) ^ CRC_T(table, 0, prev >> 8);
+            }
+        }
+    }
+}
+
+/* Engine for uart_client_set_tx_crc()/uart_client_set_rx_crc(), switched to its table kernel on first use */
+const struct uart_tx_crc *uart_crc_get(enum uart_crc_type type)
+{
+    struct uart_crc_engine *engine;
+    rt_uint32_t *table;
+    rt_base_t level;
+
+    RT_ASSERT(type < UART_CRC_TYPE_NUM);
+    engine = &uart_crc_engines[type];
+    if (engine->poly == 0 || engine->table != RT_NULL)
+        return &engine->crc;
+
+    table = rt_malloc(PKG_UART_CLIENT_CRC_SLICES * 256 * sizeof(rt_uint32_t));
+    if (table == RT_NULL)
+    {
+        LOG_W("no memory for the crc table, using the bit loop.");
+        return &engine->crc;
+    }
+    uart_crc_table_build(engine, table);
+
+    level = rt_hw_interrupt_disable();
+    if (engine->table == RT_NULL)
+    {
+        engine->table = table;
+        table = RT_NULL;
+        if (!engine->hw)
+        {
+            engine->crc.update = engine->kernels[PKG_UART_CLIENT_CRC_SLICES == 1 ? UART_CRC_KERNEL_TABLE :
+                    PKG_UART_CLIENT_CRC_SLICES == 4 ? UART_CRC_KERNEL_SLICE4 : UART_CRC_KERNEL_SLICE8];
+        }
+    }
+    rt_hw_interrupt_enable(level);
+    if (table)
+    {
+        /* built by another thread meanwhile */
+        rt_free(table);
+    }
+
+    return &engine->crc;
+}
+
+/*
+ * Hand an engine to a CRC peripheral: update(crc, data, size) must continue the
+ * running value crc the way the engine's kernels do. Call before clients use it.
+ */
+void uart_crc_set_update(enum uart_crc_type type, uart_crc_update_t update)
+{
+    struct uart_crc_engine *engine;
+
+    RT_ASSERT(type < UART_CRC_TYPE_NUM);RT_ASSERT(update);
+    engine = &uart_crc_engines[type];
+    engine->hw = RT_TRUE;
+    engine->crc.update = update;
+}
+
+/* A kernel by name, for benchmarks and self tests; RT_NULL where PKG_UART_CLIENT_CRC_SLICES has no tables for it */
+uart_crc_update_t uart_crc_kernel(enum uart_crc_type type, enum uart_crc_kernel kernel)
+{
+    const struct uart_crc_engine *engine;
+
+    RT_ASSERT(type < UART_CRC_TYPE_NUM);RT_ASSERT(kernel < UART_CRC_KERNEL_NUM);
+    uart_crc_get(type);
+    engine = &uart_crc_engines[type];
+    if (kernel == UART_CRC_KERNEL_BITWISE)
+        return engine->kernels[UART_CRC_KERNEL_BITWISE];
+    if (engine->table == RT_NULL || (kernel == UART_CRC_KERNEL_SLICE4 && PKG_UART_CLIENT_CRC_SLICES < 4)
+            || (kernel == UART_CRC_KERNEL_SLICE8 && PKG_UART_CLIENT_CRC_SLICES < 8))
+        return RT_NULL;
+    return engine->kernels[kernel];
+}
+
+/* The final value over one buffer, as it appears in the trailer before byte ordering */
+rt_uint32_t uart_crc_calc(const struct uart_tx_crc *crc, const rt_uint8_t *data, rt_size_t size)
+{
+    return crc->update(crc->init, data, size) ^ crc->xor_out;
+}
+
+#if defined(RT_USING_FINSH) && defined(PKG_UART_CLIENT_USING_BENCH)
+#include <stdlib.h>
+
+/* Throughput of every kernel over one buffer, in kilobytes per second of ticks */
+static void uart_crc_bench(int argc, char **argv)
+{
+    static const char *const type_names[UART_CRC_TYPE_NUM] = { "crc16-modbus", "crc16-ccitt", "crc32", "sum8", "xor8" };
+    static const char *const kernel_names[UART_CRC_KERNEL_NUM] = { "bitwise", "table", "slice4", "slice8" };
+    rt_size_t size = argc > 1 ? atoi(argv[1]) : 256;
+    rt_uint32_t rounds = argc > 2 ? atoi(argv[2]) : 2000;
+    volatile rt_uint32_t sink = 0;
+    uart_crc_update_t update;
+    rt_uint8_t *buf;
+    rt_tick_t ticks;
+    rt_uint32_t i;
+    int type, kernel;
+
+    buf = rt_malloc(size);
+    if (buf == RT_NULL)
+        return;
+    for (i = 0; i < size; i++)
+    {
+        buf[i] = (rt_uint8_t) (i * 131 + 7);
+    }
+
+    rt_kprintf("%d bytes x %d rounds\n", size, rounds);
+    for (type = 0; type < UART_CRC_TYPE_NUM; type++)
+    {
+        for (kernel = 0; kernel < UART_CRC_KERNEL_NUM; kernel++)
+        {
+            update = uart_crc_kernel((enum uart_crc_type) type, (enum uart_crc_kernel) kernel);
+            if (update == RT_NULL)
+                continue;
+            ticks = rt_tick_get();
+            for (i = 0; i < rounds; i++)
+            {
+                sink ^= update(i, buf, size);
+            }
+            ticks = rt_tick_get() - ticks;
+            rt_kprintf("  %-12s %-8s %6d ticks  %8d KB/s\n", type_names[type], kernel_names[kernel], ticks,
+                    ticks ? (rt_uint32_t) ((rt_uint64_t) size * rounds * RT_TICK_PER_SECOND / 1024 / ticks) : 0);
+        }
+    }
+    rt_free(buf);
+}
+MSH_CMD_EXPORT(uart_crc_bench, uart client crc kernel benchmark: [size] [rounds]);
+#endif